@@ -1,6 +1,7 @@
 #!/bin/sh
 mmap=yes
 getcunlocked=yes
+threads=yes
 debug=no
 usage () {
 cat <<EOF
@@ -13,9 +14,11 @@ where <option> is one of the following:
 
 --mmap              enable memory mapped I/O
 --getc-unlocked     use 'getc_locked' instead of 'getc'
+--threads           enable parallel scanning of log files
 
 --no-mmap           disable fast memory mapped I/O
 --no-getc-unlocked  use 'getc' instead of 'getc_unlocked'
+--no-threads        disable parallel scanning of log files
 EOF
 }
 while [ $# -gt 0 ]
@@ -27,6 +30,8 @@ do
     --getc-unlocked) getcunlocked=yes;;
     --no-mmap) mmap=no;;
     --no-getc-unlocked) getcunlocked=no;;
+    --threads) threads=yes;;
+    --no-threads) threads=no;;
     *)
       echo "*** configure.sh: invalid option '$1' (try '-h')"
       exit 1
@@ -43,5 +48,11 @@ else
 fi
 [ $mmap = no ] && COMPILE="$COMPILE -DNMMAP"
 [ $getcunlocked = no ] && COMPILE="$COMPILE -DNGETCUNLOCKED"
+if [ $threads = yes ]
+then
+  COMPILE="$COMPILE -pthread"
+else
+  COMPILE="$COMPILE -DNTHREADS"
+fi
 echo "$COMPILE"
 sed -e "s,@COMPILE@,$COMPILE," makefile.in > makefile
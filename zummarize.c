@@ -1,44 +1,72 @@
 #include <assert.h>
 #include <ctype.h>
 #include <dirent.h>
+#include <float.h>
 #include <limits.h>
+#include <math.h>
+#include <setjmp.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
-#ifndef NMMAP
 #include <fcntl.h>
+#include <fnmatch.h>
+#ifndef NTHREADS
+#include <pthread.h>
+#endif
+#ifndef NMMAP
 #include <sys/mman.h>
 #endif
 
+#include "zummarize.h"
+
 typedef struct Symbol {
   char *name;
-  struct Entry *first, *last;
   struct Symbol *next;
+  unsigned id, first, last, best;
   int sat, uns;
 } Symbol;
 
+/* Entries make up most of the memory we use and thus are kept compact.
+ * The 'symbol' and 'zummary' fields are indices into 'symbols' and
+ * 'directories' and 'chain' is the index of the next entry of the same
+ * symbol (see 'ENTRY').  Process and real time are stored in centi-seconds
+ * and space in deci-mega-bytes, which matches the precision of the numbers
+ * written to 'zummary' files.  The rare optimum values of 'o <n>' lines
+ * are kept separately in 'optima' (and then 'opt' is set).  Whether a
+ * result line was found in the log file is kept in 'line' (see
+ * 'applyparseoptions').
+ */
 typedef struct Entry {
-  Symbol *symbol;
-  const char *name;
-  struct Zummary *zummary;
-  struct Entry *next, *chain, *best;
-  char tio, meo, unk, dis, s11, si6;
-  double wll, tim, mem;
-  int res, bnd, maxubnd, minsbnd;
-  long obnd;
+  unsigned symbol, zummary, chain;
+  unsigned tim, wll, mem;
+  int bnd;
+  unsigned res : 8, tio : 1, meo : 1, unk : 1, dis : 1, s11 : 1, si6 : 1;
+  unsigned opt : 1, lzy : 1, line : 2;
 } Entry;
 
+#define LINE_UNPARSED 0
+#define LINE_MISSING 1
+#define LINE_FOUND 2
+
+typedef struct Optimum {
+  unsigned symbol, zummary;
+  long obnd;
+} Optimum;
+
 typedef struct Zummary {
   char *path;
-  Entry *first, *last;
+  unsigned id, first, last;
   int cnt, sol, sat, uns, dis, fld, tio, meo, s11, si6, unk, bnd, bst, unq;
   double wll, tim, par, mem, max, tlim, rlim, slim, deep;
-  int only_use_for_reporting_and_do_not_write;
+  int only_use_for_reporting_and_do_not_write, lazy;
   char ubndbroken, obndbroken;
+  double *metrics; // sums of metric values of solved entries
 } Zummary;
 
 typedef struct Order {
@@ -46,8 +74,204 @@ typedef struct Order {
   int order;
 } Order;
 
+typedef struct Parsed {
+  char *path;
+  Zummary *zummary;
+  double seconds;
+  long bytes;
+} Parsed;
+
+/* All options which only affect how results are reported.  They are saved
+ * and restored for each '--report' specification through 'OPTION'.
+ */
+#define REPORT_OPTIONS                                                         \
+  OPTION(int, printall)                                                        \
+  OPTION(int, satonly)                                                         \
+  OPTION(int, unsatonly)                                                       \
+  OPTION(int, deeponly)                                                        \
+  OPTION(int, center)                                                          \
+  OPTION(int, solved)                                                          \
+  OPTION(int, unsolved)                                                        \
+  OPTION(int, cmp)                                                             \
+  OPTION(int, filter)                                                          \
+  OPTION(int, nounknown)                                                       \
+  OPTION(int, plotting)                                                        \
+  OPTION(int, cactus)                                                          \
+  OPTION(int, cdf)                                                             \
+  OPTION(int, show_solved)                                                     \
+  OPTION(int, logarithmic)                                                     \
+  OPTION(int, merge)                                                           \
+  OPTION(int, rank)                                                            \
+  OPTION(int, par)                                                             \
+  OPTION(int, limit)                                                           \
+  OPTION(double, cex)                                                          \
+  OPTION(double, xmin)                                                         \
+  OPTION(double, xmax)                                                         \
+  OPTION(double, ymin)                                                         \
+  OPTION(double, ymax)                                                         \
+  OPTION(double, xlegend)                                                      \
+  OPTION(double, ylegend)                                                      \
+  OPTION(const char *, patch)                                                  \
+  OPTION(const char *, title)                                                  \
+  OPTION(const char *, outputpath)                                             \
+  OPTION(const char *, arrowpath)                                              \
+  OPTION(int, json)                                                            \
+  OPTION(int, spaceprofile)                                                    \
+  OPTION(int, matrix)                                                          \
+  OPTION(int, portfolio)                                                       \
+  OPTION(const char *, sweep)
+
+typedef struct Report {
+  char *spec, **argv;
+#define OPTION(TYPE, NAME) TYPE NAME;
+  REPORT_OPTIONS
+#undef OPTION
+} Report;
+
+/* Session options are restored by 'zummarize_option' if parsing fails.
+ * Metrics and patterns point into the failed options and are dropped by
+ * restoring their counts.
+ */
+#define SESSION_OPTIONS                                                        \
+  OPTION(int, verbose)                                                         \
+  OPTION(int, nowarnings)                                                      \
+  OPTION(int, force)                                                           \
+  OPTION(int, ignore)                                                          \
+  OPTION(int, just)                                                            \
+  OPTION(int, forced_real_limit)                                               \
+  OPTION(int, forced_time_limit)                                               \
+  OPTION(int, nowrite)                                                         \
+  OPTION(int, nobounds)                                                        \
+  OPTION(int, forcereal)                                                       \
+  OPTION(int, forcetime)                                                       \
+  OPTION(int, lazy)                                                            \
+  OPTION(unsigned, logthreads)                                                 \
+  OPTION(const char *, keywordspath)                                           \
+  OPTION(int, samples)                                                         \
+  OPTION(int, fastcheck)                                                       \
+  OPTION(unsigned, spotchecks)                                                 \
+  OPTION(int, inodeorder)                                                      \
+  OPTION(int, filtered)                                                        \
+  OPTION(unsigned, nmatches)
+
+typedef struct Settings {
+#define OPTION(TYPE, NAME) TYPE NAME;
+  SESSION_OPTIONS
+#undef OPTION
+  unsigned nmetrics;
+} Settings;
+
+typedef struct Partial {
+  char *path;
+  unsigned char *data;
+  size_t size;
+  const char **names;
+  unsigned nnames;
+} Partial;
+
+typedef struct Shard {
+  const char *path;
+  double tlim, rlim, slim;
+  int ubndbroken;
+  unsigned partial, seq, count;
+  size_t offset;
+} Shard;
+
+/* Tokens of error file and zummary lines are spans of the input buffer,
+ * which are not zero terminated.
+ */
+typedef struct Span {
+  const char *start;
+  unsigned size;
+} Span;
+
+typedef struct Cursor {
+  Zummary *zummary, limits;
+  char *path;
+  FILE *file;
+  char *lines[2];
+  size_t sizelines[2];
+  Span tokens[12];
+  int ntokens, current, line, optimum;
+  unsigned entry;
+} Cursor;
+
+typedef struct Event {
+  const char *text;
+  int res;
+} Event;
+
+typedef struct Metric {
+  char *name;
+  const char *prefix;
+} Metric;
+
+typedef struct Keywords {
+  unsigned short (*next)[256];
+  unsigned char *accept, *number;
+  unsigned short *metric;
+  char **text;
+  unsigned nstates, sizestates;
+} Keywords;
+
+typedef struct Scan {
+  const Keywords *keywords;
+  const char *top, *end, *witness, *path;
+  int last, clean, savedch, savedchvalid, nomemory;
+  int minsbnd, maxubnd;
+  long optimum;
+  Event *events;
+  unsigned nevents, sizeevents;
+  double *metrics;
+} Scan;
+
+typedef struct Flat {
+  unsigned char *bytes;
+  size_t size, capacity;
+} Flat;
+
+typedef struct Spot {
+  char *name;
+  long long size, sec;
+  long nsec;
+} Spot;
+
+#define FINGERPRINT_SPOTS 64
+
+typedef struct Fingerprint {
+  long long dev, ino, msec, csec, zsize, zsec;
+  long mnsec, cnsec, znsec;
+  unsigned count, nspots, step;
+  unsigned long long hash;
+  Spot spots[FINGERPRINT_SPOTS];
+} Fingerprint;
+
+typedef struct Walk {
+  char *path;
+  struct Walk **children;
+  unsigned nchildren;
+  int state, run, failed;
+} Walk;
+
+typedef struct Pair {
+  char *base;
+  unsigned long long ino;
+} Pair;
+
+typedef struct Score {
+  unsigned solved;
+  double time, par;
+} Score;
+
+typedef struct Writer {
+  FILE *file; // 'stdout' if zero
+  size_t size;
+  char buffer[1 << 16];
+} Writer;
+
 static int verbose, force, ignore, printall, nowrite, nobounds, par;
 static int nowarnings, satonly, unsatonly, deeponly, just, center;
+static int json, spaceprofile, matrix, portfolio;
 static int solved, unsolved, cmp, filter, nounknown;
 static int plotting, cactus, cdf, show_solved;
 static double cex=0.8;
@@ -58,43 +282,137 @@ static double xlegend = -1, ylegend = -1;
 
 static const char *patch;
 
-static const char *title, *outputpath;
+static const char *title, *outputpath, *arrowpath;
 
-static Zummary **zummaries;
+static Zummary **zummaries, **directories;
 static int nzummaries, sizezummaries;
 static int loaded, written, updated;
 
 static char *token;
-static int stoken, ntoken, sizetoken;
+static int ntoken, sizetoken;
 static int lineno;
 
-static const char **tokens;
+static Span *tokens;
 static int ntokens, sizetokens;
 
-static Symbol **symtab;
-static unsigned nsyms, sizesymtab;
+static Symbol **symtab, **symbols;
+static unsigned nsyms, sizesymtab, sizesymbols;
+
+#define LD_BLOCK 16
+#define BLOCK (1u << LD_BLOCK)
+#define ENTRY(I) (blocks[(I) >> LD_BLOCK] + ((I) & (BLOCK - 1)))
+
+#define SYMBOL(E) (symbols[(E)->symbol])
+#define ZUMMARY(E) (directories[(E)->zummary])
+#define NAME(E) (SYMBOL(E)->name)
+
+/* Metric values of entries are kept in 'values' with 'nmetrics' values per
+ * entry index (and 'NAN' if missing).
+ */
+#define VALUE(I, J) (values[(size_t)(I) * nmetrics + (J)])
+
+#define TIM(E) ((E)->tim / 100.0)
+#define WLL(E) ((E)->wll / 100.0)
+#define MEM(E) ((E)->mem / 10.0)
+
+static Entry **blocks;
+static unsigned nentries, nblocks, sizeblocks;
+
+static Optimum *optima;
+static unsigned noptima, sizeoptima;
 static unsigned long long searches, collisions;
 
-static const char *orderpath;
+static const char *orderpath, *sweep;
 static Order *order;
 static int norder;
 
 static int forcereal;
 static int forcetime;
 static int usereal;
+static int lazy;
+static unsigned logthreads;
+static int fastcheck;
+static unsigned spotchecks;
+
+static const char *keywordspath;
+static Keywords *keywords;
+
+static Metric *metrics;
+static unsigned nmetrics, sizemetrics;
+static double *values;
+static size_t sizevalues;
+
+static int filtered;
+static char **instances;
+static unsigned ninstances, sizeinstances;
+static const char **matches;
+static unsigned nmatches, sizematches;
+static char *filtername;
+static size_t sizefiltername;
+
+static int inodeorder;
+
+static int samples;
+static unsigned char *samplebytes;
+static size_t nsamplebytes, sizesamplebytes;
+static size_t *sampleoffsets, sizesampleoffsets;
+static unsigned *sampled, nsampled, sizesampled;
 
 static int capped = 1000;
 static int logarithmic;
 static int merge;
 static int rank;
 
+static int slow;
+static Parsed *parsed;
+static int nparsed, sizeparsed;
+
+static int memory;
+static size_t maxtemporary;
+
+static Report *reports;
+static int nreports, sizereports;
+
+static const char *emitpath;
+static Partial *partials;
+static int npartials, sizepartials;
+static Shard *shards, **groups;
+static unsigned nshards, sizeshards, ngroups;
+
+struct zummarize_session {
+  jmp_buf env;
+  int analyzed, broken;
+};
+
+static zummarize_session *session;
+static jmp_buf *errorjmp;
+static char errormessage[256];
+
+static int initialized;
+static Report defaults;
+
+static int stream;
+static Cursor *cursors;
+static int *heap, ncursors, nheap;
+static size_t cursorbytes;
+
+/* Keep standard output parseable if it is used for JSON.
+ */
+#define DIAGNOSTICS (json ? stderr : stdout)
+
 static void die(const char *fmt, ...) {
   va_list ap;
-  fputs("*** zummarize error: ", stdout);
+  if (errorjmp) {
+    va_start(ap, fmt);
+    vsnprintf(errormessage, sizeof errormessage, fmt, ap);
+    va_end(ap);
+    longjmp(*errorjmp, 1);
+  }
+  fputs("*** zummarize error: ", DIAGNOSTICS);
   va_start(ap, fmt);
-  vfprintf(stdout, fmt, ap);
+  vfprintf(DIAGNOSTICS, fmt, ap);
   va_end(ap);
-  fputc('\n', stdout);
+  fputc('\n', DIAGNOSTICS);
   exit(1);
 }
 
@@ -102,23 +420,35 @@ static void wrn(const char *fmt, ...) {
   va_list ap;
   if (nowarnings)
     return;
-  fputs("*** zummarize warning: ", stdout);
+  fputs("*** zummarize warning: ", DIAGNOSTICS);
   va_start(ap, fmt);
-  vfprintf(stdout, fmt, ap);
+  vfprintf(DIAGNOSTICS, fmt, ap);
   va_end(ap);
-  fputc('\n', stdout);
+  fputc('\n', DIAGNOSTICS);
 }
 
 static void msg(int level, const char *fmt, ...) {
   va_list ap;
   if (verbose < level)
     return;
-  fputs("[zummarize] ", stdout);
+  fputs("[zummarize] ", DIAGNOSTICS);
   va_start(ap, fmt);
-  vfprintf(stdout, fmt, ap);
+  vfprintf(DIAGNOSTICS, fmt, ap);
   va_end(ap);
-  fputc('\n', stdout);
-  fflush(stdout);
+  fputc('\n', DIAGNOSTICS);
+  fflush(DIAGNOSTICS);
+}
+
+static size_t file_size(const char *path) {
+  struct stat buf;
+  if (stat(path, &buf))
+    die("failed to determine size of '%s'", path);
+  return buf.st_size;
+}
+
+static void temporary(size_t bytes) {
+  if (bytes > maxtemporary)
+    maxtemporary = bytes;
 }
 
 #ifndef NMMAP
@@ -129,13 +459,6 @@ static struct {
   char *start, *top, *end;
 } input;
 
-static size_t file_size(const char *path) {
-  struct stat buf;
-  if (stat(path, &buf))
-    die("failed to determine size of '%s'", path);
-  return buf.st_size;
-}
-
 static void open_input(const char *path) {
   size_t bytes;
   assert(!input.opened);
@@ -175,6 +498,14 @@ static void close_input(const char *path) {
   input.opened = 0;
 }
 
+static void release_input() {
+  if (!input.opened)
+    return;
+  (void)munmap(input.start, input.end - input.start);
+  (void)close(input.fd);
+  input.opened = 0;
+}
+
 #else
 
 static FILE *input;
@@ -201,8 +532,37 @@ static void close_input(const char *path) {
   input = 0;
 }
 
+static void release_input() {
+  if (!input)
+    return;
+  (void)fclose(input);
+  input = 0;
+}
+
 #endif
 
+/* The directory currently read while checking, fingerprinting or updating
+ * a zummary is kept, such that it can be closed after an error in the
+ * library, which returns instead of exiting.
+ */
+static DIR *directory;
+
+static DIR *open_directory(const char *path) {
+  assert(!directory);
+  return directory = opendir(path);
+}
+
+static void close_directory() {
+  assert(directory);
+  (void)closedir(directory);
+  directory = 0;
+}
+
+static void release_directory() {
+  if (directory)
+    close_directory();
+}
+
 static int savedch = EOF, savedchvalid;
 
 static int nextch() {
@@ -214,12 +574,76 @@ static int nextch() {
   return res;
 }
 
+#ifdef NMMAP
+
 static void savech(int ch) {
   assert(!savedchvalid);
   savedchvalid = 1;
   savedch = ch;
 }
 
+#endif
+
+/* Returns the next line without its new-line character.  With memory
+ * mapping it is a span of the mapped file and thus not copied, otherwise
+ * it is read into 'linebuffer'.  The last line does not need a new-line.
+ */
+#ifndef NMMAP
+
+static int nextline(Span *line) {
+  const char *p;
+  assert(input.opened);
+  assert(!savedchvalid);
+  if (input.top == input.end)
+    return 0;
+  line->start = input.top;
+  if ((p = memchr(input.top, '\n', input.end - input.top)))
+    input.top = (char *)p + 1;
+  else
+    p = input.top = input.end;
+  if (p - line->start > UINT_MAX)
+    die("line too long");
+  line->size = p - line->start;
+  return 1;
+}
+
+#else
+
+static char *linebuffer;
+static size_t sizelinebuffer;
+
+static int nextline(Span *line) {
+  size_t n = 0;
+  int ch;
+  while ((ch = nextch()) != '\n') {
+    if (ch == EOF) {
+      if (!n)
+        return 0;
+      break;
+    }
+    if (n == sizelinebuffer) {
+      size_t newsize = sizelinebuffer ? 2 * sizelinebuffer : 128;
+      linebuffer = realloc(linebuffer, newsize);
+      if (!linebuffer)
+        die("out of memory reallocating line buffer");
+      sizelinebuffer = newsize;
+    }
+    if (n == UINT_MAX)
+      die("line too long");
+    linebuffer[n++] = ch;
+  }
+  line->start = linebuffer;
+  line->size = n;
+  return 1;
+}
+
+#endif
+
+static int isspan(Span span, const char *str) {
+  size_t size = strlen(str);
+  return span.size == size && !memcmp(span.start, str, size);
+}
+
 static const char *USAGE =
     "usage: zummarize [ <option> ... ] <dir> ... \n"
     "\n"
@@ -243,11 +667,24 @@ static const char *USAGE =
     "--show-solved  show solved in legend of plot\n"
     "--center       center legend vertically\n"
     "-m|--merge     merge zummaries by benchmark\n"
+    "--arrow <file> write merged zummaries as Arrow IPC file\n"
+    "--json         print report as JSON array of records\n"
+    "--ndjson       print report as one JSON record per line\n"
+    "--space-profile  print space percentiles over time and growth outliers\n"
+    "               per solver (implies '--samples')\n"
     "-r|--rank      print number of times benchmark has been solved\n"
     "--unsolved     print unsolved (never solved) instances\n"
     "--solved       print all at least once solved instances\n"
     "--filter       filter out solved in comparison\n"
     "--cmp          compare two runs\n"
+    "--matrix       print number of instances solved by one but not the\n"
+    "               other and Jaccard similarity for all pairs of runs\n"
+    "--portfolio <k>  select <k> runs which together solve most (or have\n"
+    "                 the best PAR score with '--par<x>') and print the\n"
+    "                 virtual best solver of all runs\n"
+    "--sweep <limits>  print solved and PAR-1/2/10 scores of all runs for\n"
+    "                  comma separated time limits, e.g., '60,300,900'\n"
+    "                  (capped at and printed as the limit of each run)\n"
     "\n"
     "--ymin <y>     minimum Y value\n"
     "--xmin <x>     minimum X value\n"
@@ -270,12 +707,58 @@ static const char *USAGE =
     "\n"
     "--force-real   force real time zummaries\n"
     "--force-time   force process time zummaries\n"
+    "--lazy         skip logs of time-outs, memory-outs and crashes\n"
+    "               unless bounds are needed (for '--deep')\n"
+    "--log-threads <n>  scan large log files in parallel with <n> threads\n"
+    "--keywords <file>  additional result lines (see below)\n"
+    "--metric <name>:<prefix>  extract metric from log lines (see below)\n"
+    "--samples      capture 'runlim' samples in '<dir>/samples' files\n"
+    "--fast-check   trust zummaries if the directory itself did not change\n"
+    "               (keeps a '<dir>/fingerprint' file next to the zummary)\n"
+    "--spot-check <n>  fast check plus checking <n> sampled files\n"
+    "--inode-order  parse files in inode order (for archives on disks)\n"
+    "--instances <file>  only zummarize instances listed in '<file>'\n"
+    "--match <glob>     only zummarize instances matching '<glob>'\n"
+    "                   (filtered zummaries are not written)\n"
+    "\n"
+    "--slow <n>     report parse latency histograms per directory and\n"
+    "               the <n> slowest and largest parsed files\n"
+    "--memory       report memory usage of internal data structures\n"
+    "               (both printed to 'stderr' with '--json' or '--ndjson')\n"
+    "--stream       merge cached zummaries one benchmark at a time\n"
+    "\n"
+    "--emit-partial <file>  write binary partial instead of a report\n"
+    "--combine <file>       add directories of partial (multiple allowed)\n"
+    "--recursive <root>     add all run directories below '<root>' in sorted\n"
+    "                       order, i.e., those with a 'zummary' file or\n"
+    "                       '.err' and '.log' files (multiple allowed)\n"
+    "\n"
+    "--report '<opts>'      generate report with additional report options\n"
+    "                       instead of the default report (multiple allowed)\n"
+    "                       where '-o <file>' writes the report to '<file>'\n"
+    "                       (a global '-o' is only allowed for one report)\n"
     "\n"
     "The directory arguments are considered to have '.err' files generated\n"
     "by the 'runlim' tool and '.log' files which adhere loosly to the output\n"
     "file requirements used in the SAT, SMT and HWMCC competitions.  The tool\n"
     "will by default write '<dir>/zummary' file unless there are already such\n"
-    "zummaries available, which will then be used for caching results.\n";
+    "zummaries available, which will then be used for caching results.\n"
+    "\n"
+    "Result lines are recognized through keywords, which can be extended\n"
+    "and redefined by '--keywords <file>' and in each directory by a file\n"
+    "'<dir>/keywords'.  Each line of such a file has the form\n"
+    "\n"
+    "  ( sat | unsat | unknown ) <keyword>\n"
+    "\n"
+    "where the rest of the line is the keyword (lines starting with '#' are\n"
+    "ignored), e.g., 'unsat s UNSATISFIABLE'.  Log lines matching 'unknown'\n"
+    "keywords are recognized but do not give a result.\n"
+    "\n"
+    "A metric is the first number following its prefix at the start of a\n"
+    "log line (the last such line counts), e.g., '--metric conflicts:\"c\n"
+    "conflicts:\"'.  Metrics are cached as extra columns in zummaries and\n"
+    "are reported by '--merge' (and '--arrow') and as sums over solved\n"
+    "instances in the table.  Multiple '--metric' options can be given.\n";
 
 static void usage() {
   fputs(USAGE, stdout);
@@ -313,8 +796,13 @@ static Zummary *newzummary(const char *path) {
     zummaries = realloc(zummaries, newsize * sizeof *zummaries);
     if (!zummaries)
       die("out of memory reaallocating zummaries stack");
+    directories = realloc(directories, newsize * sizeof *directories);
+    if (!directories)
+      die("out of memory reaallocating directories stack");
     sizezummaries = newsize;
   }
+  res->id = nzummaries;
+  directories[nzummaries] = res;
   zummaries[nzummaries++] = res;
   return res;
 }
@@ -343,99 +831,132 @@ static char *appendpath(const char *prefix, const char *name) {
 static void pushtoken(int ch) {
   if (ntoken == sizetoken) {
     int newsizetoken = sizetoken ? 2 * sizetoken : 1;
-    char *oldtoken = token;
-    long delta;
     token = realloc(token, newsizetoken);
     if (!token)
       die("out of memory reallocating token buffer");
     sizetoken = newsizetoken;
-    if ((delta = token - oldtoken)) {
-      int i;
-      for (i = 0; i < ntokens; i++)
-        tokens[i] += delta;
-    }
   }
   if (ntoken == INT_MAX)
     die("token buffer overflow");
   token[ntoken++] = ch;
 }
 
-static int pusherrtokens() {
-  const char *res;
-  int skip;
-  pushtoken(0);
-  res = token + stoken;
-  if (!ntokens && strcmp(res, "[run]") && strcmp(res, "[runlim]")) {
-    msg(3, "skipping line starting with '%s'", res);
-    skip = 1;
-  } else if (ntokens == 1 && !strcmp(res, "sample:")) {
-    msg(3, "skipping sample line");
-    skip = 1;
-  } else
-    skip = 0;
-  if (skip) {
-    int ch;
-    while ((ch = nextch()) != '\n')
-      if (ch == EOF)
-        break;
-    if (ch == '\n')
-      lineno++;
-    ntokens = ntoken = stoken = 0;
-    return 0;
+/* Locale independent parsing of the numbers in error files, zummaries and
+ * log lines, which are almost always of the form '123.45' or '1024.0'.
+ * Parsing stops at the first character not part of the number, so no
+ * terminating zero is needed.  With at most 15 significant digits the
+ * mantissa and the power of ten are exact doubles and their quotient is
+ * correctly rounded, i.e., the same as the result of 'strtod', which is
+ * still used for all other forms, e.g., with exponents.
+ */
+static const double powersoften[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static double parsedecimal(const char *str, const char *end,
+                           const char **endptr) {
+  const char *p = str;
+  unsigned long long mantissa = 0;
+  int negative = 0, digits = 0, decimals = -1, any = 0;
+  double res;
+  if (p < end && (*p == '-' || *p == '+'))
+    negative = (*p++ == '-');
+  for (; p < end; p++) {
+    if (isdigit((unsigned char)*p)) {
+      if (mantissa || *p != '0')
+        digits++;
+      mantissa = 10 * mantissa + (*p - '0');
+      if (decimals >= 0)
+        decimals++;
+      any = 1;
+    } else if (*p == '.' && decimals < 0)
+      decimals = 0;
+    else
+      break;
   }
-  if (sizetokens == ntokens) {
-    int newsizetokens = sizetokens ? 2 * sizetokens : 1;
-    tokens = realloc(tokens, newsizetokens * sizeof *tokens);
-    if (!tokens)
-      die("out of memory reallocating token stack");
-    sizetokens = newsizetokens;
+  if (!any || digits > 15 || decimals > 22 ||
+      (p < end && (*p == 'e' || *p == 'E' || *p == 'x' || *p == 'X'))) {
+    char buffer[64], *q;
+    size_t n = end - str < (long)sizeof buffer ? end - str : sizeof buffer - 1;
+    memcpy(buffer, str, n);
+    buffer[n] = 0;
+    res = strtod(buffer, &q);
+    if (endptr)
+      *endptr = str + (q - buffer);
+    return res;
   }
-  if (ntokens == INT_MAX)
-    die("token stack overflow");
-  tokens[ntokens++] = res;
-  stoken = ntoken;
-  return 1;
+  if (endptr)
+    *endptr = p;
+  res = decimals > 0 ? mantissa / powersoften[decimals] : mantissa;
+  return negative ? -res : res;
 }
 
-static int parserrline() {
-  int i, newline = 0, res = 1;
-  stoken = ntoken = ntokens = 0;
-  for (;;) {
-    int ch = nextch();
-    if (ch == EOF) {
-      res = 0;
-      break;
-    }
-    if (ch == '\n') {
-      newline = 1;
-      break;
-    }
-    if (ch == ' ' || ch == '\t' || ch == '\r') {
-      assert(ntokens < 5 || ntoken == stoken);
-      if (stoken < ntoken && !pusherrtokens())
-        break;
-      continue;
-    }
-    if (ntokens < 5)
-      pushtoken(ch);
-    else
-      assert(stoken == ntoken);
+static int parseinteger(const char *p, const char *end) {
+  int negative = 0, res = 0;
+  if (p < end && (*p == '-' || *p == '+'))
+    negative = (*p++ == '-');
+  while (p < end && isdigit((unsigned char)*p))
+    res = 10 * res + (*p++ - '0');
+  return negative ? -res : res;
+}
+
+static double spandecimal(Span span) {
+  return parsedecimal(span.start, span.start + span.size, 0);
+}
+
+static int spaninteger(Span span) {
+  return parseinteger(span.start, span.start + span.size);
+}
+
+/* With '--samples' the time series of 'runlim' sample lines
+ *
+ *   [runlim] sample:    6.7 time, 6.7 real, 54.8 MB, 1.0 load
+ *
+ * is captured per entry, as pairs of time and space in tenths of seconds
+ * and mega-bytes.  These are collected in 'sampled' while parsing the
+ * error file and then stored compactly by 'storesamples'.
+ */
+static void addsample(unsigned time, unsigned space) {
+  if (nsampled + 2 > sizesampled) {
+    unsigned newsizesampled = sizesampled ? 2 * sizesampled : 64;
+    sampled = realloc(sampled, newsizesampled * sizeof *sampled);
+    if (!sampled)
+      die("out of memory reallocating samples");
+    sizesampled = newsizesampled;
   }
-  assert(ntokens < 5 || stoken == ntoken);
-  if (stoken < ntoken)
-    (void)pusherrtokens();
-  if (verbose > 2)
-    for (i = 0; i < ntokens; i++)
-      msg(3, "token[%d,%d] %s", lineno, i, tokens[i]);
-  if (newline)
-    lineno++;
-  return res;
+  sampled[nsampled++] = time;
+  sampled[nsampled++] = space;
 }
 
-static void pushzummarytokens() {
-  const char *res;
-  pushtoken(0);
-  res = token + stoken;
+static unsigned tenths(double d) {
+  if (d <= 0)
+    return 0;
+  if (d >= UINT_MAX / 10.0)
+    return UINT_MAX;
+  return d * 10 + 0.5;
+}
+
+/* Parses the rest '[p, end)' of a sample line.  Lines without at least
+ * three numbers are ignored.
+ */
+static void parsesample(const char *p, const char *end) {
+  unsigned found = 0;
+  double numbers[3];
+  const char *q;
+  for (; found < 3 && p < end; p = q)
+    if (isdigit((unsigned char)*p)) {
+      numbers[found++] = parsedecimal(p, end, &q);
+      while (q < end && !isspace((unsigned char)*q))
+        q++;
+    } else
+      q = p + 1;
+  if (found == 3)
+    addsample(tenths(numbers[0]), tenths(numbers[2]));
+  else
+    msg(2, "ignoring incomplete sample line %d", lineno);
+}
+
+static void pushspan(const char *start, const char *end) {
   if (sizetokens == ntokens) {
     int newsizetokens = sizetokens ? 2 * sizetokens : 1;
     tokens = realloc(tokens, newsizetokens * sizeof *tokens);
@@ -445,35 +966,76 @@ static void pushzummarytokens() {
   }
   if (ntokens == INT_MAX)
     die("token stack overflow");
-  tokens[ntokens++] = res;
-  stoken = ntoken;
+  tokens[ntokens].start = start;
+  tokens[ntokens++].size = end - start;
 }
 
-static int parsezummaryline() {
-  int i, newline = 0;
-  stoken = ntoken = ntokens = 0;
-  for (;;) {
-    int ch = nextch();
-    if (ch == EOF)
-      break;
-    if (ch == '\n') {
-      newline = 1;
+#define SEPARATOR(CH) ((CH) == ' ' || (CH) == '\t' || (CH) == '\r')
+
+/* Adds tokens of '[p, end)' until there are 'max' tokens and returns a
+ * pointer to the rest after the last token.
+ */
+static const char *splitspan(const char *p, const char *end, int max) {
+  const char *start;
+  while (ntokens < max) {
+    while (p < end && SEPARATOR(*p))
+      p++;
+    if (p == end)
       break;
-    }
-    if (ch == ' ' || ch == '\t' || ch == '\r') {
-      if (stoken < ntoken)
-        pushzummarytokens();
-      continue;
-    }
-    pushtoken(ch);
+    for (start = p; p < end && !SEPARATOR(*p); p++)
+      ;
+    pushspan(start, p);
   }
-  if (stoken < ntoken)
-    pushzummarytokens();
+  return p;
+}
+
+static void printtokens() {
+  int i;
+  for (i = 0; i < ntokens; i++)
+    msg(3, "token[%d,%d] %.*s", lineno, i, (int)tokens[i].size,
+        tokens[i].start);
+}
+
+/* Only lines starting with '[run]' or '[runlim]' are relevant and only
+ * their first five tokens are needed.  Sample lines are skipped unless
+ * samples are captured.
+ */
+static int parserrline() {
+  const char *rest, *end;
+  Span line;
+  ntokens = 0;
+  if (!nextline(&line))
+    return 0;
+  end = line.start + line.size;
+  rest = splitspan(line.start, end, 2);
+  if (ntokens && !isspan(tokens[0], "[run]") &&
+      !isspan(tokens[0], "[runlim]")) {
+    msg(3, "skipping line starting with '%.*s'", (int)tokens[0].size,
+        tokens[0].start);
+    ntokens = 0;
+  } else if (ntokens == 2 && isspan(tokens[1], "sample:")) {
+    if (samples)
+      parsesample(rest, end);
+    else
+      msg(3, "skipping sample line");
+    ntokens = 0;
+  } else
+    splitspan(rest, end, 5);
+  if (verbose > 2)
+    printtokens();
+  lineno++;
+  return 1;
+}
+
+static int parsezummaryline() {
+  Span line;
+  ntokens = 0;
+  if (!nextline(&line))
+    return 0;
+  splitspan(line.start, line.start + line.size, INT_MAX);
   if (verbose > 2)
-    for (i = 0; i < ntokens; i++)
-      msg(3, "token[%d,%d] %s", lineno, i, tokens[i]);
-  if (newline)
-    lineno++;
+    printtokens();
+  lineno++;
   return ntokens;
 }
 
@@ -545,26 +1107,213 @@ static char *stripsuffix(const char *str, const char *suffix) {
   return res;
 }
 
-static int zummaryneedsupdate(Zummary *z, const char *path) {
-  struct dirent *dirent;
-  double ztime;
-  int res = 0;
-  DIR *dir;
-  if (!getmtime(path, &ztime))
+/*------------------------------------------------------------------------*/
+
+/* With '--instances <file>' and '--match <glob>' only the selected
+ * instances are zummarized.  Names are filtered while scanning directories
+ * and loading zummaries, before any file of an instance is accessed or an
+ * entry is created.  Instances have to be listed in one of the instance
+ * files (if any is given) and match one of the patterns (if any is given).
+ */
+
+static unsigned hashname(const char *, size_t);
+
+static unsigned findinstance(const char *name, size_t size) {
+  unsigned h = hashname(name, size) & (sizeinstances - 1);
+  const char *other;
+  while ((other = instances[h]) &&
+         (strncmp(other, name, size) || other[size]))
+    h = (h + 1) & (sizeinstances - 1);
+  return h;
+}
+
+static void enlargeinstances() {
+  unsigned oldsize = sizeinstances, i;
+  char **old = instances;
+  sizeinstances = oldsize ? 2 * oldsize : 1 << 10;
+  if (!(instances = calloc(sizeinstances, sizeof *instances)))
+    die("out of memory allocating instance table");
+  for (i = 0; i < oldsize; i++)
+    if (old[i])
+      instances[findinstance(old[i], strlen(old[i]))] = old[i];
+  free(old);
+}
+
+static void insertinstance(const char *name) {
+  unsigned h;
+  if (2 * (ninstances + 1) > sizeinstances)
+    enlargeinstances();
+  h = findinstance(name, strlen(name));
+  if (instances[h])
+    return;
+  if (!(instances[h] = strdup(name)))
+    die("out of memory copying instance name");
+  ninstances++;
+}
+
+/* Reads one instance name per line ignoring surrounding white space and
+ * empty lines.
+ */
+static void readinstances(const char *path) {
+  unsigned before = ninstances;
+  char *start, *end;
+  if (!isfile(path))
+    die("instances file '%s' not found", path);
+  if (!sizeinstances)
+    enlargeinstances();
+  open_input(path);
+  while (parseorderline()) {
+    for (start = token; isspace((unsigned char)*start); start++)
+      ;
+    for (end = start + strlen(start);
+         end > start && isspace((unsigned char)end[-1]); end--)
+      ;
+    *end = 0;
+    if (*start)
+      insertinstance(start);
+  }
+  close_input(path);
+  msg(1, "read %u instances from '%s'", ninstances - before, path);
+  filtered = 1;
+}
+
+static void newmatch(const char *pattern) {
+  if (nmatches == sizematches) {
+    sizematches = sizematches ? 2 * sizematches : 1;
+    matches = realloc(matches, sizematches * sizeof *matches);
+    if (!matches)
+      die("out of memory reallocating patterns");
+  }
+  matches[nmatches++] = pattern;
+  filtered = 1;
+}
+
+/* The name is not necessarily zero terminated if it is a token of a mapped
+ * zummary file, so it is copied for 'fnmatch'.
+ */
+static int selected(const char *name, size_t size) {
+  unsigned i;
+  if (!filtered)
     return 1;
-  if (!(dir = opendir(z->path)))
-    die("can not open directory '%s' for checking times", z->path);
-  while (!res && (dirent = readdir(dir))) {
-    char *base, *logname, *logpath;
-    const char *errname = dirent->d_name;
-    msg(2, "checking '%s'", errname);
-    if (!(base = stripsuffix(errname, ".err"))) {
-      msg(2, "skipping '%s'", errname);
-      continue;
-    }
-    logname = appendstr(base, ".log");
-    logpath = appendpath(z->path, logname);
-    if (isfile(logpath)) {
+  if (sizeinstances && !instances[findinstance(name, size)])
+    return 0;
+  if (!nmatches)
+    return 1;
+  if (size >= sizefiltername) {
+    sizefiltername = 2 * size + 1;
+    free(filtername);
+    if (!(filtername = malloc(sizefiltername)))
+      die("out of memory allocating instance name");
+  }
+  memcpy(filtername, name, size);
+  filtername[size] = 0;
+  for (i = 0; i < nmatches; i++)
+    if (!fnmatch(matches[i], filtername, 0))
+      return 1;
+  return 0;
+}
+
+static void deletefilter() {
+  unsigned i;
+  for (i = 0; i < sizeinstances; i++)
+    free(instances[i]);
+  free(instances);
+  free(matches);
+  free(filtername);
+  instances = 0, ninstances = sizeinstances = 0;
+  matches = 0, nmatches = sizematches = 0;
+  filtername = 0, sizefiltername = 0;
+  filtered = 0;
+}
+
+/*------------------------------------------------------------------------*/
+
+static unsigned long long hashbytes(unsigned long long h, const void *bytes,
+                                    size_t n) {
+  const unsigned char *p = bytes, *end = p + n;
+  while (p < end)
+    h = (h ^ *p++) * 1099511628211ull;
+  return h;
+}
+
+static unsigned long long hashcontents(unsigned long long h,
+                                       const char *path) {
+  char buffer[1 << 12];
+  FILE *file;
+  size_t n;
+  if (!(file = fopen(path, "r")))
+    die("can not read '%s'", path);
+  while ((n = fread(buffer, 1, sizeof buffer, file)))
+    h = hashbytes(h, buffer, n);
+  fclose(file);
+  return hashbytes(h, "", 1);
+}
+
+/* Zummaries depend on the keywords of '--keywords' and '<dir>/keywords'.
+ * A hash of the contents of these files is written as 'keywords:<hash>'
+ * marker to the header of a zummary (see 'writezummary'), unless there is
+ * no such file.  Thus changing, adding and removing keyword files makes
+ * zummaries stale, independently of modification times.
+ */
+static unsigned long long keywordshash(Zummary *z) {
+  char *path = appendpath(z->path, "keywords");
+  unsigned long long h = 14695981039346656037ull;
+  int files = 0;
+  if (keywordspath)
+    h = hashcontents(h, keywordspath), files++;
+  if (isfile(path))
+    h = hashcontents(h, path), files++;
+  free(path);
+  return files ? h : 0;
+}
+
+static unsigned long long zummarykeywords(const char *path) {
+  unsigned long long res = 0;
+  size_t size = 0;
+  char *line = 0, *p;
+  FILE *file;
+  if (!(file = fopen(path, "r")))
+    return 0;
+  if (getline(&line, &size, file) > 0 && (p = strstr(line, " keywords:")))
+    res = strtoull(p + 10, 0, 10);
+  free(line);
+  fclose(file);
+  return res;
+}
+
+static int keywordschanged(Zummary *z, const char *path) {
+  if (keywordshash(z) == zummarykeywords(path))
+    return 0;
+  msg(1, "keywords of '%s' changed", path);
+  return 1;
+}
+
+static int zummaryneedsupdate(Zummary *z, const char *path) {
+  struct dirent *dirent;
+  double ztime;
+  int res = 0;
+  DIR *dir;
+  if (!getmtime(path, &ztime))
+    return 1;
+  if (keywordschanged(z, path))
+    return 1;
+  if (!(dir = open_directory(z->path)))
+    die("can not open directory '%s' for checking times", z->path);
+  while (!res && (dirent = readdir(dir))) {
+    char *base, *logname, *logpath;
+    const char *errname = dirent->d_name;
+    msg(2, "checking '%s'", errname);
+    if (!(base = stripsuffix(errname, ".err"))) {
+      msg(2, "skipping '%s'", errname);
+      continue;
+    }
+    if (!selected(base, strlen(base))) {
+      free(base);
+      continue;
+    }
+    logname = appendstr(base, ".log");
+    logpath = appendpath(z->path, logname);
+    if (isfile(logpath)) {
       char *errpath = appendpath(z->path, errname);
       double etime;
       if (getmtime(errpath, &etime)) {
@@ -583,13 +1332,267 @@ static int zummaryneedsupdate(Zummary *z, const char *path) {
         }
       } else
         res = 1;
+      free(errpath);
     } else
       msg(1, "missing '%s'", logpath);
     free(logpath);
     free(logname);
     free(base);
   }
-  (void)closedir(dir);
+  close_directory();
+  return res;
+}
+
+/* With '--fast-check' a fingerprint of the directory is kept next to its
+ * zummary in '<dir>/fingerprint':
+ *
+ *   zummarize-fingerprint 1
+ *   directory <dev> <ino> <mtime> <mtime-ns> <ctime> <ctime-ns>
+ *   zummary <size> <mtime> <mtime-ns>
+ *   files <count> <hash>
+ *   ( <size> <mtime> <mtime-ns> <name> )*
+ *
+ * The hash is the sum of hashes of name, size and modification time of all
+ * '.err' and '.log' files, followed by up to 'FINGERPRINT_SPOTS' of these
+ * files spread over the directory for spot checks.  Adding, removing or
+ * renaming files changes the directory, so if neither the directory nor
+ * the zummary changed, the zummary is considered up-to-date without
+ * looking at any file.  Files modified in place are only noticed by spot
+ * checks ('--spot-check').  Otherwise the fingerprint of all files is
+ * compared, and only without valid fingerprint for the zummary are
+ * modification times checked as without '--fast-check'.
+ */
+
+#ifdef __APPLE__
+#define MTIMENSEC(S) ((S).st_mtimespec.tv_nsec)
+#define CTIMENSEC(S) ((S).st_ctimespec.tv_nsec)
+#else
+#define MTIMENSEC(S) ((S).st_mtim.tv_nsec)
+#define CTIMENSEC(S) ((S).st_ctim.tv_nsec)
+#endif
+
+#define FINGERPRINT_MAGIC "zummarize-fingerprint 1"
+
+static unsigned long long hashfile(const char *name, const struct stat *buf) {
+  unsigned long long h = 14695981039346656037ull;
+  long long size = buf->st_size, sec = buf->st_mtime, nsec = MTIMENSEC(*buf);
+  h = hashbytes(h, name, strlen(name) + 1);
+  h = hashbytes(h, &size, sizeof size);
+  h = hashbytes(h, &sec, sizeof sec);
+  h = hashbytes(h, &nsec, sizeof nsec);
+  h ^= h >> 31, h *= 0x9e3779b97f4a7c15ull, h ^= h >> 29;
+  return h;
+}
+
+static void clearfingerprint(Fingerprint *f) {
+  unsigned i;
+  for (i = 0; i < f->nspots; i++)
+    free(f->spots[i].name);
+  memset(f, 0, sizeof *f);
+}
+
+static int directoryfingerprint(Zummary *z, const char *zpath,
+                                Fingerprint *f) {
+  struct stat buf;
+  if (stat(z->path, &buf))
+    return 0;
+  f->dev = buf.st_dev, f->ino = buf.st_ino;
+  f->msec = buf.st_mtime, f->mnsec = MTIMENSEC(buf);
+  f->csec = buf.st_ctime, f->cnsec = CTIMENSEC(buf);
+  if (stat(zpath, &buf))
+    return 0;
+  f->zsize = buf.st_size;
+  f->zsec = buf.st_mtime, f->znsec = MTIMENSEC(buf);
+  return 1;
+}
+
+/* Spots are every 'step'th file, where 'step' is doubled (dropping every
+ * other spot) whenever all spots are taken.
+ */
+static void addspot(Fingerprint *f, const char *name, const struct stat *buf) {
+  Spot *spot;
+  unsigned i;
+  if (!f->step)
+    f->step = 1;
+  if ((f->count - 1) % f->step)
+    return;
+  if (f->nspots == FINGERPRINT_SPOTS) {
+    for (i = 0; i < FINGERPRINT_SPOTS; i++)
+      if (i & 1)
+        free(f->spots[i].name);
+      else
+        f->spots[i / 2] = f->spots[i];
+    f->nspots = FINGERPRINT_SPOTS / 2;
+    f->step *= 2;
+    if ((f->count - 1) % f->step)
+      return;
+  }
+  spot = f->spots + f->nspots++;
+  if (!(spot->name = strdup(name)))
+    die("out of memory copying spot name");
+  spot->size = buf->st_size;
+  spot->sec = buf->st_mtime, spot->nsec = MTIMENSEC(*buf);
+}
+
+static void filesfingerprint(Zummary *z, Fingerprint *f) {
+  struct dirent *dirent;
+  struct stat buf;
+  DIR *dir;
+  if (!(dir = open_directory(z->path)))
+    die("can not open directory '%s' for fingerprinting", z->path);
+  while ((dirent = readdir(dir))) {
+    const char *name = dirent->d_name;
+    size_t len = strlen(name);
+    char *path;
+    if (len < 4 ||
+        (strcmp(name + len - 4, ".err") && strcmp(name + len - 4, ".log")))
+      continue;
+    path = appendpath(z->path, name);
+    if (!stat(path, &buf)) {
+      f->hash += hashfile(name, &buf);
+      f->count++;
+      addspot(f, name, &buf);
+    }
+    free(path);
+  }
+  close_directory();
+  msg(1, "fingerprint of %u files in '%s' is %016llx", f->count, z->path,
+      f->hash);
+}
+
+static int readfingerprint(const char *path, Fingerprint *f) {
+  size_t size = 0;
+  char *line = 0;
+  FILE *file;
+  int res;
+  Spot spot;
+  ssize_t n;
+  if (!(file = fopen(path, "r")))
+    return 0;
+  res = fscanf(file,
+               FINGERPRINT_MAGIC " directory %lld %lld %lld %ld %lld %ld"
+                                 " zummary %lld %lld %ld files %u %llx",
+               &f->dev, &f->ino, &f->msec, &f->mnsec, &f->csec, &f->cnsec,
+               &f->zsize, &f->zsec, &f->znsec, &f->count, &f->hash) == 11;
+  while (res && f->nspots < FINGERPRINT_SPOTS &&
+         fscanf(file, "%lld %lld %ld ", &spot.size, &spot.sec, &spot.nsec) ==
+             3) {
+    if ((n = getline(&line, &size, file)) <= 1 || line[n - 1] != '\n') {
+      res = 0;
+      break;
+    }
+    line[n - 1] = 0;
+    if (!(spot.name = strdup(line)))
+      die("out of memory copying spot name");
+    f->spots[f->nspots++] = spot;
+  }
+  if (res && !feof(file) && fgetc(file) != EOF)
+    res = 0;
+  free(line);
+  fclose(file);
+  if (!res) {
+    msg(1, "invalid fingerprint '%s'", path);
+    clearfingerprint(f);
+  }
+  return res;
+}
+
+/* Creating the fingerprint file would change the directory, so it is
+ * created first and then overwritten in place after taking the stamp of
+ * the directory.  Readers of a partially written fingerprint consider it
+ * invalid and fall back to checking all files.
+ */
+static void writefingerprint(Zummary *z, const char *zpath, const char *path,
+                             Fingerprint *f) {
+  FILE *file;
+  unsigned i;
+  if (!isfile(path) && (file = fopen(path, "w")))
+    fclose(file);
+  if (!directoryfingerprint(z, zpath, f))
+    return;
+  if (!(file = fopen(path, "w")))
+    die("can not write '%s'", path);
+  fprintf(file, "%s\ndirectory %lld %lld %lld %ld %lld %ld\n",
+          FINGERPRINT_MAGIC, f->dev, f->ino, f->msec, f->mnsec, f->csec,
+          f->cnsec);
+  fprintf(file, "zummary %lld %lld %ld\nfiles %u %016llx\n", f->zsize, f->zsec,
+          f->znsec, f->count, f->hash);
+  for (i = 0; i < f->nspots; i++)
+    fprintf(file, "%lld %lld %ld %s\n", f->spots[i].size, f->spots[i].sec,
+            f->spots[i].nsec, f->spots[i].name);
+  if (fclose(file))
+    die("failed to write '%s'", path);
+  msg(1, "written fingerprint '%s'", path);
+}
+
+static int samedirectory(Fingerprint *f, Fingerprint *g) {
+  return f->dev == g->dev && f->ino == g->ino && f->msec == g->msec &&
+         f->mnsec == g->mnsec && f->csec == g->csec && f->cnsec == g->cnsec;
+}
+
+static int samezummary(Fingerprint *f, Fingerprint *g) {
+  return f->zsize == g->zsize && f->zsec == g->zsec && f->znsec == g->znsec;
+}
+
+static int spotcheck(Zummary *z, Fingerprint *f) {
+  unsigned i, n = spotchecks < f->nspots ? spotchecks : f->nspots, start;
+  struct stat buf;
+  int res = 1;
+  if (!n)
+    return 1;
+  start = time(0) % f->nspots;
+  for (i = 0; res && i < n; i++) {
+    Spot *spot = f->spots + (start + (size_t)i * f->nspots / n) % f->nspots;
+    char *path = appendpath(z->path, spot->name);
+    if (stat(path, &buf) || buf.st_size != spot->size ||
+        buf.st_mtime != spot->sec || MTIMENSEC(buf) != spot->nsec) {
+      msg(1, "spot check of '%s' failed", path);
+      res = 0;
+    }
+    free(path);
+  }
+  if (res)
+    msg(1, "spot checked %u files in '%s'", n, z->path);
+  return res;
+}
+
+static int zummarystale(Zummary *z, const char *path) {
+  Fingerprint stored, current;
+  int res, valid, complete = 1;
+  char *fpath;
+  double ztime;
+  if (!fastcheck)
+    return zummaryneedsupdate(z, path);
+  if (!getmtime(path, &ztime) || keywordschanged(z, path))
+    return 1;
+  memset(&stored, 0, sizeof stored);
+  memset(&current, 0, sizeof current);
+  fpath = appendpath(z->path, "fingerprint");
+  valid = readfingerprint(fpath, &stored);
+  if (!directoryfingerprint(z, path, &current))
+    res = 1;
+  else if (valid && samezummary(&stored, &current) &&
+           samedirectory(&stored, &current)) {
+    msg(1, "directory '%s' unchanged", z->path);
+    res = !spotcheck(z, &stored);
+  } else {
+    filesfingerprint(z, &current);
+    if (valid && samezummary(&stored, &current)) {
+      res = stored.count != current.count || stored.hash != current.hash;
+      msg(1, "files in '%s' %s", z->path, res ? "changed" : "unchanged");
+    } else {
+      res = zummaryneedsupdate(z, path);
+      /* Only selected files are checked with '--instances' or '--match',
+       * so they do not vouch for the fingerprint of all files.
+       */
+      complete = !filtered;
+    }
+    if (!res && !nowrite && complete)
+      writefingerprint(z, path, fpath, &current);
+  }
+  clearfingerprint(&stored);
+  clearfingerprint(&current);
+  free(fpath);
   return res;
 }
 
@@ -597,18 +1600,21 @@ static unsigned primes[] = {111111113, 222222227, 333333349, 444444457};
 
 #define NPRIMES (sizeof primes / sizeof primes[0])
 
-static unsigned hashstr(const char *name) {
+static unsigned hashname(const char *name, size_t size) {
   unsigned res = 0, i = 0;
-  const char *p;
-  char ch;
-  for (p = name; (ch = *p); p++) {
-    res += primes[i++] * (unsigned)ch;
+  const char *p, *end = name + size;
+  for (p = name; p < end; p++) {
+    res += primes[i++] * (unsigned)*p;
     if (i == NPRIMES)
       i = 0;
   }
   return res;
 }
 
+static unsigned hashstr(const char *name) {
+  return hashname(name, strlen(name));
+}
+
 static void enlargesymtab() {
   unsigned newsizesymtab = sizesymtab ? 2 * sizesymtab : 1;
   Symbol *s, *n, **newsymtab;
@@ -617,6 +1623,7 @@ static void enlargesymtab() {
   newsymtab = malloc(bytes);
   if (!newsymtab)
     die("out of memory reallocating symbol table");
+  temporary(sizesymtab * sizeof *symtab);
   memset(newsymtab, 0, bytes);
   for (i = 0; i < sizesymtab; i++) {
     for (s = symtab[i]; s; s = n) {
@@ -631,49 +1638,166 @@ static void enlargesymtab() {
   sizesymtab = newsizesymtab;
 }
 
-static Entry *newentry(Zummary *z, const char *name) {
-  Entry *res = malloc(sizeof *res);
+static Entry *entry(unsigned idx) { return idx ? ENTRY(idx) : 0; }
+
+/* Entries are allocated in fixed size blocks, such that they never move,
+ * and the index zero is reserved to denote 'no entry'.  The entries of a
+ * zummary are allocated in one go and thus occupy the index range
+ * '[z->first, z->last)'.
+ */
+static unsigned newentryindex(Zummary *z) {
+  unsigned res;
+  if (nentries == UINT_MAX)
+    die("entry index overflow");
+  if ((nentries >> LD_BLOCK) == nblocks) {
+    if (nblocks == sizeblocks) {
+      unsigned newsizeblocks = sizeblocks ? 2 * sizeblocks : 1;
+      blocks = realloc(blocks, newsizeblocks * sizeof *blocks);
+      if (!blocks)
+        die("out of memory reallocating entry blocks");
+      sizeblocks = newsizeblocks;
+    }
+    blocks[nblocks] = malloc(BLOCK * sizeof **blocks);
+    if (!blocks[nblocks++])
+      die("out of memory allocating entry block");
+    if (!nentries)
+      nentries++;
+  }
+  res = nentries++;
+  if (nmetrics) {
+    size_t needed = (size_t)nentries * nmetrics;
+    unsigned j;
+    if (needed > sizevalues) {
+      size_t newsizevalues = sizevalues ? 2 * sizevalues : needed;
+      while (newsizevalues < needed)
+        newsizevalues *= 2;
+      values = realloc(values, newsizevalues * sizeof *values);
+      if (!values)
+        die("out of memory reallocating metric values");
+      sizevalues = newsizevalues;
+    }
+    for (j = 0; j < nmetrics; j++)
+      VALUE(res, j) = NAN;
+  }
+  if (samples && nentries > sizesampleoffsets) {
+    size_t newsize = sizesampleoffsets ? 2 * sizesampleoffsets : BLOCK;
+    while (newsize < nentries)
+      newsize *= 2;
+    sampleoffsets = realloc(sampleoffsets, newsize * sizeof *sampleoffsets);
+    if (!sampleoffsets)
+      die("out of memory reallocating sample offsets");
+    memset(sampleoffsets + sizesampleoffsets, 0,
+           (newsize - sizesampleoffsets) * sizeof *sampleoffsets);
+    sizesampleoffsets = newsize;
+  }
+  if (z->first == z->last)
+    z->first = res;
+  else
+    assert(z->last == res);
+  z->last = res + 1;
+  return res;
+}
+
+/* The 'name' of 'size' bytes does not have to be zero terminated.
+ */
+static Entry *newentry(Zummary *z, const char *name, size_t size) {
+  unsigned h, idx = newentryindex(z);
+  Entry *res = ENTRY(idx);
   Symbol *s, **p;
-  unsigned h;
-  if (!res)
-    die("out of memory allocating entry object");
   memset(res, 0, sizeof *res);
-  res->zummary = z;
-  res->bnd = res->maxubnd = res->minsbnd = -1;
-  res->obnd = -1;
+  res->zummary = z->id;
+  res->bnd = -1;
   if (nsyms == sizesymtab)
     enlargesymtab();
-  h = hashstr(name) & (sizesymtab - 1);
+  h = hashname(name, size) & (sizesymtab - 1);
   searches++;
-  for (p = symtab + h; (s = *p) && strcmp(s->name, name); p = &s->next)
+  for (p = symtab + h;
+       (s = *p) && (strncmp(s->name, name, size) || s->name[size]);
+       p = &s->next)
     collisions++;
   if (!s) {
     s = malloc(sizeof *s);
     if (!s)
       die("out of memory allocating symbol object");
     memset(s, 0, sizeof *s);
-    s->name = strdup(name);
+    s->name = malloc(size + 1);
     if (!s->name)
       die("out of memory copying symbol name");
-    nsyms++;
+    memcpy(s->name, name, size);
+    s->name[size] = 0;
+    if (nsyms == sizesymbols) {
+      unsigned newsizesymbols = sizesymbols ? 2 * sizesymbols : 1;
+      symbols = realloc(symbols, newsizesymbols * sizeof *symbols);
+      if (!symbols)
+        die("out of memory reallocating symbols stack");
+      sizesymbols = newsizesymbols;
+    }
+    s->id = nsyms;
+    symbols[nsyms++] = s;
     *p = s;
   }
-  res->name = s->name;
-  res->symbol = s;
-  if (s->last)
-    s->last->chain = res;
-  else
-    s->first = res;
-  s->last = res;
+  res->symbol = s->id;
   z->cnt++;
-  if (z->last)
-    z->last->next = res;
-  else
-    z->first = res;
-  z->last = res;
   return res;
 }
 
+static void newoptimum(Entry *e, long obnd) {
+  Optimum *o;
+  if (noptima == sizeoptima) {
+    unsigned newsizeoptima = sizeoptima ? 2 * sizeoptima : 1;
+    optima = realloc(optima, newsizeoptima * sizeof *optima);
+    if (!optima)
+      die("out of memory reallocating optima stack");
+    sizeoptima = newsizeoptima;
+  }
+  o = optima + noptima++;
+  o->symbol = e->symbol;
+  o->zummary = e->zummary;
+  o->obnd = obnd;
+  e->opt = 1;
+}
+
+static int cmpoptima4qsort(const void *p, const void *q) {
+  const Optimum *a = p, *b = q;
+  if (a->symbol != b->symbol)
+    return a->symbol < b->symbol ? -1 : 1;
+  if (a->zummary != b->zummary)
+    return a->zummary < b->zummary ? -1 : 1;
+  return 0;
+}
+
+/* Optima found in log files are kept in an 'optimum' column of zummaries,
+ * which is only written if there is one.  Entries without have '-1'.
+ */
+static int hasoptima(Zummary *z) {
+  unsigned i;
+  for (i = z->first; i < z->last; i++)
+    if (ENTRY(i)->opt)
+      return 1;
+  return 0;
+}
+
+static long getoptimum(Entry *e) {
+  Optimum key, *o;
+  if (!e->opt)
+    return -1;
+  key.symbol = e->symbol;
+  key.zummary = e->zummary;
+  o = bsearch(&key, optima, noptima, sizeof *optima, cmpoptima4qsort);
+  assert(o);
+  return o->obnd;
+}
+
+static unsigned fixedpoint(double d, double scale) {
+  double res = d * scale + 0.5;
+  if (res >= UINT_MAX)
+    return UINT_MAX;
+  return res;
+}
+
+static unsigned centi(double d) { return fixedpoint(d, 100); }
+static unsigned deci(double d) { return fixedpoint(d, 10); }
+
 enum {
   TLIM = 0,
   RLIM = 1,
@@ -702,13 +1826,14 @@ static int parserrfile(Entry *e, const char *errpath) {
   for (i = 0; i < MAX; i++)
     found[i] = 0;
   lineno = 1;
+  nsampled = 0;
   while (parserrline()) {
     if (!ntokens)
       continue;
-    assert(!strcmp(tokens[0], "[run]") || !strcmp(tokens[0], "[runlim]"));
-    if (ntokens > 3 && !strcmp(tokens[1], "time") &&
-        !strcmp(tokens[2], "limit:")) {
-      double tlim = atof(tokens[3]);
+    assert(isspan(tokens[0], "[run]") || isspan(tokens[0], "[runlim]"));
+    if (ntokens > 3 && isspan(tokens[1], "time") &&
+        isspan(tokens[2], "limit:")) {
+      double tlim = spandecimal(tokens[3]);
       msg(2, "found time limit '%.0f' in '%s'", tlim, errpath);
       if (found[TLIM]) {
         msg(1, "error file '%s' contains two 'time limit:' lines", errpath);
@@ -719,18 +1844,18 @@ static int parserrfile(Entry *e, const char *errpath) {
           msg(1, "error file '%s' with invalid time limit '%.0f'", errpath,
               tlim);
           res = 0;
-        } else if (e->zummary->tlim < 0) {
+        } else if (ZUMMARY(e)->tlim < 0) {
           msg(1, "assuming time limit '%.0f'", tlim);
-          e->zummary->tlim = tlim;
-        } else if (e->zummary->tlim != tlim) {
+          ZUMMARY(e)->tlim = tlim;
+        } else if (ZUMMARY(e)->tlim != tlim) {
           msg(1, "error file '%s' with different time limit '%.0f'", errpath,
               tlim);
           res = 0;
         }
       }
-    } else if (ntokens > 4 && !strcmp(tokens[1], "real") &&
-               !strcmp(tokens[2], "time") && !strcmp(tokens[3], "limit:")) {
-      double rlim = atof(tokens[4]);
+    } else if (ntokens > 4 && isspan(tokens[1], "real") &&
+               isspan(tokens[2], "time") && isspan(tokens[3], "limit:")) {
+      double rlim = spandecimal(tokens[4]);
       msg(2, "found real time limit '%.0f' in '%s'", rlim, errpath);
       if (found[RLIM]) {
         msg(1, "error file '%s' contains two 'real time limit:' lines",
@@ -742,18 +1867,18 @@ static int parserrfile(Entry *e, const char *errpath) {
           msg(1, "error file '%s' with invalid real time limit '%.0f'", errpath,
               rlim);
           res = 0;
-        } else if (e->zummary->rlim < 0) {
+        } else if (ZUMMARY(e)->rlim < 0) {
           msg(1, "assuming real time limit '%.0f'", rlim);
-          e->zummary->rlim = rlim;
-        } else if (e->zummary->rlim != rlim) {
+          ZUMMARY(e)->rlim = rlim;
+        } else if (ZUMMARY(e)->rlim != rlim) {
           msg(1, "error file '%s' with different real time limit '%.0f'",
               errpath, rlim);
           res = 0;
         }
       }
-    } else if (ntokens > 3 && !strcmp(tokens[1], "space") &&
-               !strcmp(tokens[2], "limit:")) {
-      double slim = atof(tokens[3]);
+    } else if (ntokens > 3 && isspan(tokens[1], "space") &&
+               isspan(tokens[2], "limit:")) {
+      double slim = spandecimal(tokens[3]);
       msg(2, "found space limit '%.0f' in '%s'", slim, errpath);
       if (found[SLIM]) {
         msg(1, "error file '%s' contains two 'space limit:' lines", errpath);
@@ -764,42 +1889,42 @@ static int parserrfile(Entry *e, const char *errpath) {
           msg(1, "error file '%s' with invalid space limit '%.0f'", errpath,
               slim);
           res = 0;
-        } else if (e->zummary->slim < 0) {
+        } else if (ZUMMARY(e)->slim < 0) {
           msg(1, "assuming space limit '%.0f'", slim);
-          e->zummary->slim = slim;
-        } else if (e->zummary->slim != slim) {
+          ZUMMARY(e)->slim = slim;
+        } else if (ZUMMARY(e)->slim != slim) {
           msg(1, "error file '%s' with different space limit '%.0f'", errpath,
               slim);
-          if (e->zummary->slim < slim) {
+          if (ZUMMARY(e)->slim < slim) {
             msg(1, "increasing space limit to '%.0f'", slim);
-            e->zummary->slim = slim;
+            ZUMMARY(e)->slim = slim;
           }
         }
       }
-    } else if (ntokens > 2 && !strcmp(tokens[1], "status:")) {
+    } else if (ntokens > 2 && isspan(tokens[1], "status:")) {
       if (found[STATUS]) {
         msg(1, "error file '%s' contains two 'status:' lines", errpath);
         res = 0;
-      } else if (!strcmp(tokens[2], "ok")) {
+      } else if (isspan(tokens[2], "ok")) {
         msg(2, "found 'ok' status in '%s'", errpath);
         found[STATUS] = 1;
-      } else if (!strcmp(tokens[2], "signal(11)") ||
-                 (ntokens > 3 && !strcmp(tokens[2], "segmentation") &&
-                  !strcmp(tokens[3], "fault"))) {
+      } else if (isspan(tokens[2], "signal(11)") ||
+                 (ntokens > 3 && isspan(tokens[2], "segmentation") &&
+                  isspan(tokens[3], "fault"))) {
         msg(2, "found 'ok' status in '%s'", errpath);
         found[STATUS] = 1;
         e->s11 = 1;
-      } else if (!strcmp(tokens[2], "signal(6)")) {
+      } else if (isspan(tokens[2], "signal(6)")) {
         msg(2, "found 'ok' status in '%s'", errpath);
         found[STATUS] = 1;
         e->si6 = 1;
-      } else if (ntokens > 4 && !strcmp(tokens[2], "out") &&
-                 !strcmp(tokens[3], "of") && !strcmp(tokens[4], "time")) {
+      } else if (ntokens > 4 && isspan(tokens[2], "out") &&
+                 isspan(tokens[3], "of") && isspan(tokens[4], "time")) {
         msg(2, "found 'out of time' status in '%s'", errpath);
         found[STATUS] = 1;
         e->tio = 1;
-      } else if (ntokens > 4 && !strcmp(tokens[2], "out") &&
-                 !strcmp(tokens[3], "of") && !strcmp(tokens[4], "memory")) {
+      } else if (ntokens > 4 && isspan(tokens[2], "out") &&
+                 isspan(tokens[3], "of") && isspan(tokens[4], "memory")) {
         msg(2, "found 'out of memory' status in '%s'", errpath);
         found[STATUS] = 1;
         e->meo = 1;
@@ -807,12 +1932,12 @@ static int parserrfile(Entry *e, const char *errpath) {
         msg(1, "invalid status line in '%s'", errpath);
         found[STATUS] = 1;
       }
-    } else if (ntokens > 2 && !strcmp(tokens[1], "result:")) {
+    } else if (ntokens > 2 && isspan(tokens[1], "result:")) {
       if (found[RESULT]) {
         msg(1, "error file '%s' contains two 'result:' lines", errpath);
         res = 0;
       } else {
-        int result = atoi(tokens[2]);
+        int result = spaninteger(tokens[2]);
         found[RESULT] = 1;
         if (!result) {
           msg(2, "found '0' result in '%s'", errpath);
@@ -824,8 +1949,8 @@ static int parserrfile(Entry *e, const char *errpath) {
           msg(2, "found invalid '%d' result in '%s'", result, errpath);
         }
       }
-    } else if (ntokens > 2 && !strcmp(tokens[1], "time:")) {
-      double time = atof(tokens[2]);
+    } else if (ntokens > 2 && isspan(tokens[1], "time:")) {
+      double time = spandecimal(tokens[2]);
       msg(2, "found time '%.2f' in '%s'", time, errpath);
       if (found[TIME]) {
         msg(1, "error file '%s' contains two 'time:' lines", errpath);
@@ -836,10 +1961,10 @@ static int parserrfile(Entry *e, const char *errpath) {
           msg(1, "invalid time '%.2f' in '%s'", time, errpath);
           res = 0;
         } else
-          e->tim = time;
+          e->tim = centi(time);
       }
-    } else if (ntokens > 2 && !strcmp(tokens[1], "real:")) {
-      double real = atof(tokens[2]);
+    } else if (ntokens > 2 && isspan(tokens[1], "real:")) {
+      double real = spandecimal(tokens[2]);
       msg(2, "found real time '%.2f' in '%s'", real, errpath);
       if (found[REAL]) {
         msg(1, "error file '%s' contains two 'real:' lines", errpath);
@@ -850,10 +1975,10 @@ static int parserrfile(Entry *e, const char *errpath) {
           msg(1, "invalid real time '%.2f' in '%s'", real, errpath);
           res = 0;
         } else
-          e->wll = real;
+          e->wll = centi(real);
       }
-    } else if (ntokens > 2 && !strcmp(tokens[1], "space:")) {
-      double space = atof(tokens[2]);
+    } else if (ntokens > 2 && isspan(tokens[1], "space:")) {
+      double space = spandecimal(tokens[2]);
       msg(2, "found space '%.1f' in '%s'", space, errpath);
       if (found[SPACE]) {
         msg(1, "error file '%s' contains two 'space:' lines", errpath);
@@ -864,7 +1989,7 @@ static int parserrfile(Entry *e, const char *errpath) {
           msg(1, "invalid space '%.1f' in '%s'", space, errpath);
           res = 0;
         } else
-          e->mem = space;
+          e->mem = deci(space);
       }
     }
   }
@@ -885,158 +2010,556 @@ static int parserrfile(Entry *e, const char *errpath) {
 }
 
 static int cmpentry4qsort(const void *p, const void *q) {
-  Entry *d = *(Entry **)p, *e = *(Entry **)q;
-  return strcmp(d->name, e->name);
+  const Entry *d = p, *e = q;
+  return strcmp(NAME(d), NAME(e));
+}
+
+/* Moves the metric values and sample offsets along with the sorted
+ * 'entries' of 'z', which have their original index temporarily stored in
+ * 'chain'.
+ */
+static void sortvalues(Zummary *z, Entry *entries) {
+  unsigned i, n = z->last - z->first;
+  double *sorted = 0;
+  size_t *offsets = 0;
+  if (nmetrics && !(sorted = malloc((size_t)n * nmetrics * sizeof *sorted)))
+    die("out of memory allocating sorted metric values");
+  if (samples && !(offsets = malloc(n * sizeof *offsets)))
+    die("out of memory allocating sorted sample offsets");
+  for (i = 0; i < n; i++) {
+    unsigned idx = entries[i].chain;
+    if (sorted)
+      memcpy(sorted + (size_t)i * nmetrics, &VALUE(idx, 0),
+             nmetrics * sizeof *sorted);
+    if (offsets)
+      offsets[i] = sampleoffsets[idx];
+    entries[i].chain = ENTRY(idx)->chain;
+  }
+  if (sorted)
+    memcpy(&VALUE(z->first, 0), sorted,
+           (size_t)n * nmetrics * sizeof *sorted);
+  if (offsets)
+    memcpy(sampleoffsets + z->first, offsets, n * sizeof *offsets);
+  free(sorted);
+  free(offsets);
 }
 
+/* Sorts the entries of the zummary by name (in place, since they are
+ * already sorted if loaded from a 'zummary' file) and then appends them to
+ * the chains of their symbols.
+ */
+
 static void sortzummary(Zummary *z) {
-  Entry **entries, *p;
-  int i;
-  if (!z->cnt)
-    return;
-  entries = malloc(z->cnt * sizeof *entries);
-  if (!entries)
-    die("out of memory allocating sorting array");
-  i = 0;
-  for (p = z->first; p; p = p->next)
-    assert(i < z->cnt), entries[i++] = p;
-  assert(i == z->cnt);
-  qsort(entries, z->cnt, sizeof *entries, cmpentry4qsort);
-  z->first = entries[0];
-  for (i = 0; i < z->cnt - 1; i++)
-    entries[i]->next = entries[i + 1];
-  (z->last = entries[i])->next = 0;
-  free(entries);
-}
-
-static int getposint(int ch) {
-  int res, digit;
-  assert(isdigit(ch));
-  res = ch - '0';
-  while (isdigit(ch = nextch())) {
-    if (INT_MAX / 10 < res)
-      return -1;
-    res *= 10;
-    digit = (ch - '0');
-    if (INT_MAX - digit < res)
-      return -1;
-    res += digit;
+  unsigned i, n = z->last - z->first;
+  Entry *entries;
+  for (i = z->first + 1; i < z->last; i++)
+    if (cmpentry4qsort(ENTRY(i - 1), ENTRY(i)) > 0)
+      break;
+  if (i < z->last) {
+    entries = malloc(n * sizeof *entries);
+    if (!entries)
+      die("out of memory allocating sorting array");
+    temporary(n * sizeof *entries);
+    for (i = 0; i < n; i++)
+      entries[i] = *ENTRY(z->first + i);
+    if (nmetrics || samples)
+      for (i = 0; i < n; i++)
+        entries[i].chain = z->first + i;
+    qsort(entries, n, sizeof *entries, cmpentry4qsort);
+    if (nmetrics || samples)
+      sortvalues(z, entries);
+    for (i = 0; i < n; i++)
+      *ENTRY(z->first + i) = entries[i];
+    free(entries);
+  }
+  for (i = z->first; i < z->last; i++) {
+    Symbol *s = SYMBOL(ENTRY(i));
+    if (s->last)
+      ENTRY(s->last)->chain = i;
+    else
+      s->first = i;
+    s->last = i;
   }
-  if (ch != '\n')
-    return -1;
-  return res;
 }
 
-static long getposlong(int ch) {
-  long res;
-  int digit;
-  assert(isdigit(ch));
-  res = ch - '0';
-  while (isdigit(ch = nextch())) {
-    if (LONG_MAX / 10 < res)
-      return -1;
-    res *= 10;
-    digit = (ch - '0');
-    if (LONG_MAX - digit < res)
-      return -1;
-    res += digit;
+/*------------------------------------------------------------------------*/
+
+/* Result lines are recognized by a keyword automaton with a dense byte
+ * transition table, generated from 'defaultkeywords' and extended by
+ * keyword files.  State '0' is the failure state and 'KEYWORDS_ROOT' the
+ * initial state at the start of a line.  A line matches a keyword if the
+ * state reached before its new line character accepts the keyword.  The
+ * bound lines 's<n>', 'u<n>' and 'o <n>' are recognized by switching to
+ * number parsing if a digit is read in a state marked by 'number'.  Since
+ * keywords and metric prefixes are anchored at the start of a line, this
+ * trie is all we need to match them in one pass.  The last state of a
+ * metric prefix is marked by 'NUMBER_METRIC' and has no transitions.
+ */
+
+#define KEYWORDS_ROOT 1
+
+#define KEYWORD_WITNESS 1 // '1' line starting an AIGER witness
+#define KEYWORD_UNKNOWN 3
+#define KEYWORD_SAT 10
+#define KEYWORD_UNSAT 20
+
+#define NUMBER_SBND 1
+#define NUMBER_UBND 2
+#define NUMBER_OPTIMUM 3
+#define NUMBER_METRIC 4
+
+static struct {
+  const char *keyword, *name; // 'name' is reported (if different)
+  int res;
+} defaultkeywords[] = {
+    {"0", 0, KEYWORD_UNSAT},
+    {"sat", 0, KEYWORD_SAT},
+    {"unsat", 0, KEYWORD_UNSAT},
+    {"SATISFIABLE", 0, KEYWORD_SAT},
+    {"UNSATISFIABLE", 0, KEYWORD_UNSAT},
+    {"s SATISFIABLE", 0, KEYWORD_SAT},
+    {"s UNSATISFIABLE", 0, KEYWORD_UNSAT},
+    {"s VERIFIED", 0, KEYWORD_UNSAT},
+    {"s OPTIMUM FOUND", 0, KEYWORD_SAT},
+    {"s OPTIMIUM FOUND", "s OPTIMUM FOUND", KEYWORD_SAT}, // TODO remove ...
+};
+
+static unsigned newkeywordstate(Keywords *k) {
+  unsigned res;
+  if (k->nstates == k->sizestates) {
+    unsigned newsizestates = k->sizestates ? 2 * k->sizestates : 64;
+    if (newsizestates > USHRT_MAX + 1u)
+      newsizestates = USHRT_MAX + 1u;
+    if (k->nstates == newsizestates)
+      die("too many keyword states");
+    k->next = realloc(k->next, newsizestates * sizeof *k->next);
+    k->accept = realloc(k->accept, newsizestates);
+    k->number = realloc(k->number, newsizestates);
+    k->metric = realloc(k->metric, newsizestates * sizeof *k->metric);
+    k->text = realloc(k->text, newsizestates * sizeof *k->text);
+    if (!k->next || !k->accept || !k->number || !k->metric || !k->text)
+      die("out of memory reallocating keyword automaton");
+    k->sizestates = newsizestates;
   }
-  if (ch != '\n')
-    return -1;
+  res = k->nstates++;
+  memset(k->next[res], 0, sizeof *k->next);
+  k->accept[res] = k->number[res] = 0;
+  k->metric[res] = 0;
+  k->text[res] = 0;
   return res;
 }
 
-#define UBND_LOCALLY_BROKEN 1  // Actually only used for assertion
-#define UBND_GLOBALLY_BROKEN 2 // checking and a proper warning below.
+static unsigned keywordstate(Keywords *k, const char *keyword,
+                             const char *path) {
+  unsigned state = KEYWORDS_ROOT, next;
+  const char *p;
+  for (p = keyword; *p; p++) {
+    unsigned char ch = *p;
+    if (k->number[state] == NUMBER_METRIC)
+      die("'%s' in '%s' clashes with metric prefix", keyword, path);
+    if (k->number[state] && isdigit(ch))
+      die("'%s' in '%s' clashes with bound lines", keyword, path);
+    if (!(next = k->next[state][ch])) {
+      next = newkeywordstate(k);
+      k->next[state][ch] = next;
+    }
+    state = next;
+  }
+  return state;
+}
 
-static void setubndbroken(Entry *e, int broken_level) {
-  assert(broken_level == UBND_LOCALLY_BROKEN ||
-         broken_level == UBND_GLOBALLY_BROKEN);
-  if (e->zummary->ubndbroken >= broken_level)
-    return;
-  wrn("assuming 'u...' lines are %s broken in '%s'",
-      broken_level == UBND_GLOBALLY_BROKEN ? "globally" : "locally",
-      e->zummary->path);
-  e->zummary->ubndbroken = broken_level;
+static void addkeyword(Keywords *k, const char *keyword, const char *name,
+                       int res, const char *path) {
+  unsigned state = keywordstate(k, keyword, path);
+  if (k->accept[state] == KEYWORD_WITNESS)
+    die("can not redefine AIGER witness line '%s' in '%s'", keyword, path);
+  if (k->accept[state])
+    msg(1, "redefining keyword '%s' in '%s'", keyword, path);
+  free(k->text[state]);
+  if (!(k->text[state] = strdup(name ? name : keyword)))
+    die("out of memory adding keyword");
+  k->accept[state] = res;
 }
 
-static void parselogfile(Entry *e, const char *logpath) {
-  const char *other = 0, *this = 0;
-  int found, ch, bnd;
-  long obnd = -1;
-  assert(!e->res);
-  msg(2, "parsing log file '%s'", logpath);
-  open_input(logpath);
-  e->res = found = 0;
-START:
-  ch = nextch();
-  if (ch == EOF)
-    goto DONE;
-  if (ch == '\n' || ch == '\r')
-    goto START;
-  if (ch == '1')
-    goto SEEN_1;
-  if (ch == '0')
-    goto SEEN_0;
-  if (ch == 's')
-    goto SEEN_S;
-  if (ch == 'u')
-    goto SEEN_U;
-  if (ch == 'o')
-    goto SEEN_O;
-  if (ch == 'S')
-    goto SEEN_C_S;
-  if (ch == 'U')
-    goto SEEN_C_U;
-WAIT:
-  ch = nextch();
-  if (ch == EOF)
-    goto DONE;
-  if (ch == '\n')
-    goto START;
-  goto WAIT;
-SEEN_0:
-  ch = nextch();
-  if (ch != '\n')
-    goto WAIT;
-  this = "0";
-UNSAT:
-  assert(ch == '\n');
-  e->res = 20;
-RESULT:
-  msg(2, "found '%s' line in '%s'", this, logpath);
-  if (other) {
-    if (strcmp(other, this))
-      die("two different results '%s' and '%s' in '%s'", other, this, logpath);
-    else
-      wrn("two (identical) results '%s' and '%s' in '%s'", other, this,
-          logpath);
+static void addmetric(Keywords *k, unsigned j) {
+  const char *prefix = metrics[j].prefix;
+  unsigned state = keywordstate(k, prefix, "--metric"), ch;
+  int clash = k->accept[state] || k->number[state];
+  for (ch = 0; !clash && ch < 256; ch++)
+    clash = k->next[state][ch];
+  if (clash)
+    die("metric prefix '%s' clashes with keywords or other metrics", prefix);
+  k->number[state] = NUMBER_METRIC;
+  k->metric[state] = j;
+}
+
+static int parsekeywordsline() {
+  int ch;
+  ntoken = 0;
+  while ((ch = nextch()) != '\n') {
+    if (ch == EOF) {
+      if (!ntoken)
+        return 0;
+      break;
+    }
+    pushtoken(ch);
   }
-  other = this;
-  goto START;
-SEEN_1:
-  ch = nextch();
-  if (ch != '\n')
-    goto WAIT;
-  this = "1";
-START_OF_WITNESS:
-  ch = nextch();
-  if (ch == 'c') {
-    while ((ch = nextch()) != '\n')
+  while (ntoken && isspace((unsigned char)token[ntoken - 1]))
+    ntoken--;
+  pushtoken(0);
+  return 1;
+}
+
+static void readkeywords(Keywords *k, const char *path) {
+  int line = 0, count = 0, res;
+  char *p, *keyword;
+  open_input(path);
+  while (parsekeywordsline()) {
+    line++;
+    for (p = token; isspace((unsigned char)*p); p++)
+      ;
+    if (!*p || *p == '#')
+      continue;
+    for (keyword = p; *keyword && !isspace((unsigned char)*keyword); keyword++)
+      ;
+    if (*keyword)
+      *keyword++ = 0;
+    while (isspace((unsigned char)*keyword))
+      keyword++;
+    if (!strcmp(p, "sat"))
+      res = KEYWORD_SAT;
+    else if (!strcmp(p, "unsat"))
+      res = KEYWORD_UNSAT;
+    else if (!strcmp(p, "unknown"))
+      res = KEYWORD_UNKNOWN;
+    else
+      die("invalid result '%s' in line %d of '%s'", p, line, path);
+    if (!*keyword)
+      die("keyword missing in line %d of '%s'", line, path);
+    addkeyword(k, keyword, 0, res, path);
+    count++;
+  }
+  close_input(path);
+  msg(1, "read %d keywords from '%s'", count, path);
+}
+
+static Keywords *newkeywords(const char *dirkeywordspath) {
+  const char *builtin = "built-in keywords";
+  Keywords *k = calloc(1, sizeof *k);
+  size_t i;
+  if (!k)
+    die("out of memory allocating keyword automaton");
+  (void)newkeywordstate(k);
+  (void)newkeywordstate(k);
+  k->number[keywordstate(k, "s", builtin)] = NUMBER_SBND;
+  k->number[keywordstate(k, "u", builtin)] = NUMBER_UBND;
+  k->number[keywordstate(k, "o ", builtin)] = NUMBER_OPTIMUM;
+  addkeyword(k, "1", 0, KEYWORD_WITNESS, builtin);
+  for (i = 0; i < sizeof defaultkeywords / sizeof *defaultkeywords; i++)
+    addkeyword(k, defaultkeywords[i].keyword, defaultkeywords[i].name,
+               defaultkeywords[i].res, builtin);
+  if (keywordspath)
+    readkeywords(k, keywordspath);
+  if (dirkeywordspath)
+    readkeywords(k, dirkeywordspath);
+  for (i = 0; i < nmetrics; i++)
+    addmetric(k, i);
+  msg(2, "keyword automaton with %u states", k->nstates);
+  return k;
+}
+
+static void deletekeywords(Keywords *k) {
+  unsigned i;
+  if (!k)
+    return;
+  for (i = 0; i < k->nstates; i++)
+    free(k->text[i]);
+  free(k->text);
+  free(k->metric);
+  free(k->number);
+  free(k->accept);
+  free(k->next);
+  free(k);
+}
+
+/* The keywords of a directory are those of '--keywords' and its optional
+ * '<dir>/keywords' file, which takes precedence.
+ */
+static Keywords *directorykeywords(Zummary *z) {
+  char *path = appendpath(z->path, "keywords");
+  Keywords *res;
+  if (isfile(path))
+    res = newkeywords(path);
+  else {
+    if (!keywords)
+      keywords = newkeywords(0);
+    res = keywords;
+  }
+  free(path);
+  return res;
+}
+
+/*------------------------------------------------------------------------*/
+
+/* Log files are scanned by 'scanlog', which records results and warnings
+ * in order as events and collects bounds in a 'Scan', such that the final
+ * result can be determined afterwards by 'parselogfile'.  This allows to
+ * split large memory mapped log files into chunks at line boundaries and
+ * scan them in parallel (see 'scanchunks').
+ */
+
+static void initscan(Scan *scan, const Keywords *keywords, const char *start,
+                     const char *end, int last) {
+  memset(scan, 0, sizeof *scan);
+  scan->keywords = keywords;
+  scan->top = start;
+  scan->end = end;
+  scan->last = last;
+  scan->minsbnd = scan->maxubnd = -1;
+  scan->optimum = -1;
+  if (nmetrics) {
+    unsigned j;
+    if (!(scan->metrics = malloc(nmetrics * sizeof *scan->metrics)))
+      die("out of memory allocating metrics of log");
+    for (j = 0; j < nmetrics; j++)
+      scan->metrics[j] = NAN;
+  }
+}
+
+static int scannext(Scan *scan) {
+#ifndef NMMAP
+  if (scan->savedchvalid)
+    return scan->savedchvalid = 0, scan->savedch;
+  if (scan->top == scan->end)
+    return EOF;
+  return (unsigned char)*scan->top++;
+#else
+  (void)scan;
+  return nextch();
+#endif
+}
+
+/* Skips the rest of the current line and returns '\n' or 'EOF'.
+ */
+static int scanline(Scan *scan) {
+  int ch;
+#ifndef NMMAP
+  const char *p;
+  if (!scan->savedchvalid) {
+    p = memchr(scan->top, '\n', scan->end - scan->top);
+    if (!p) {
+      scan->top = scan->end;
+      return EOF;
+    }
+    scan->top = p + 1;
+    return '\n';
+  }
+#endif
+  while ((ch = scannext(scan)) != '\n' && ch != EOF)
+    ;
+  return ch;
+}
+
+static void scansave(Scan *scan, int ch) {
+#ifndef NMMAP
+  assert(!scan->savedchvalid);
+  scan->savedchvalid = 1;
+  scan->savedch = ch;
+#else
+  (void)scan;
+  savech(ch);
+#endif
+}
+
+/* Results have 'res' set to '10' or '20'.  Otherwise 'text' is the format
+ * of a warning about the log file.  Since scanning might run in a thread,
+ * running out of memory is only recorded and reported by 'parselogfile'.
+ */
+static void addscanevent(Scan *scan, const char *text, int res) {
+  if (scan->nomemory)
+    return;
+  if (scan->nevents == scan->sizeevents) {
+    unsigned newsizeevents = scan->sizeevents ? 2 * scan->sizeevents : 4;
+    Event *events = realloc(scan->events, newsizeevents * sizeof *events);
+    if (!events) {
+      scan->nomemory = 1;
+      return;
+    }
+    scan->events = events;
+    scan->sizeevents = newsizeevents;
+  }
+  scan->events[scan->nevents].text = text;
+  scan->events[scan->nevents++].res = res;
+}
+
+static int getposint(Scan *scan, int ch) {
+  int res, digit;
+  assert(isdigit(ch));
+  res = ch - '0';
+  while (isdigit(ch = scannext(scan))) {
+    if (INT_MAX / 10 < res)
+      return -1;
+    res *= 10;
+    digit = (ch - '0');
+    if (INT_MAX - digit < res)
+      return -1;
+    res += digit;
+  }
+  if (ch != '\n')
+    return -1;
+  return res;
+}
+
+static long getposlong(Scan *scan, int ch) {
+  long res;
+  int digit;
+  assert(isdigit(ch));
+  res = ch - '0';
+  while (isdigit(ch = scannext(scan))) {
+    if (LONG_MAX / 10 < res)
+      return -1;
+    res *= 10;
+    digit = (ch - '0');
+    if (LONG_MAX - digit < res)
+      return -1;
+    res += digit;
+  }
+  if (ch != '\n')
+    return -1;
+  return res;
+}
+
+#define UBND_LOCALLY_BROKEN 1  // Actually only used for assertion
+#define UBND_GLOBALLY_BROKEN 2 // checking and a proper warning below.
+
+static void setubndbroken(Entry *e, int broken_level) {
+  assert(broken_level == UBND_LOCALLY_BROKEN ||
+         broken_level == UBND_GLOBALLY_BROKEN);
+  Zummary *z = ZUMMARY(e);
+  if (z->ubndbroken >= broken_level)
+    return;
+  wrn("assuming 'u...' lines are %s broken in '%s'",
+      broken_level == UBND_GLOBALLY_BROKEN ? "globally" : "locally", z->path);
+  z->ubndbroken = broken_level;
+}
+
+static void scanlog(Scan *scan, const char *logpath) {
+  const Keywords *k = scan->keywords;
+  const char *this = 0, *line = 0, *p;
+  char buffer[128];
+  unsigned state, n;
+  int ch, bnd, res;
+  long obnd;
+START:
+  ch = scannext(scan);
+  if (ch == EOF)
+    goto DONE;
+  if (ch == '\n' || ch == '\r')
+    goto START;
+  if (!scan->last)
+    line = scan->top - 1;
+  state = KEYWORDS_ROOT;
+KEYWORD:
+  if (k->number[state]) {
+    if (k->number[state] == NUMBER_METRIC)
+      goto METRIC;
+    if (isdigit(ch))
+      goto NUMBER;
+  }
+  if (!(state = k->next[state][ch]))
+    goto WAIT;
+  ch = scannext(scan);
+  if (ch == EOF)
+    goto DONE;
+  if (ch != '\n')
+    goto KEYWORD;
+  this = k->text[state];
+  switch (k->accept[state]) {
+  case KEYWORD_SAT:
+    goto SAT;
+  case KEYWORD_UNSAT:
+    goto UNSAT;
+  case KEYWORD_WITNESS:
+    scan->witness = line;
+    goto START_OF_WITNESS;
+  case KEYWORD_UNKNOWN:
+    msg(2, "found '%s' line in '%s'", this, logpath);
+    goto START;
+  default:
+    goto START;
+  }
+WAIT:
+  if (scanline(scan) == EOF)
+    goto DONE;
+  goto START;
+NUMBER:
+  if (k->number[state] == NUMBER_SBND) {
+    bnd = getposint(scan, ch);
+    if (bnd < 0)
+      goto WAIT;
+    msg(2, "found 's%d' line", bnd);
+    if (scan->minsbnd < 0 || scan->minsbnd > bnd)
+      scan->minsbnd = bnd;
+  } else if (k->number[state] == NUMBER_UBND) {
+    bnd = getposint(scan, ch);
+    if (bnd < 0)
+      goto WAIT;
+    msg(2, "found 'u%d' line", bnd);
+    if (scan->maxubnd < 0 || scan->maxubnd < bnd)
+      scan->maxubnd = bnd;
+  } else {
+    assert(k->number[state] == NUMBER_OPTIMUM);
+    obnd = getposlong(scan, ch);
+    if (obnd < 0)
+      goto WAIT;
+    msg(2, "found 'o %ld' line in '%s'", obnd, logpath);
+    scan->optimum = obnd;
+  }
+  goto START;
+METRIC:
+  n = 0;
+  while (ch != '\n' && ch != EOF) {
+    if (n + 1 < sizeof buffer)
+      buffer[n++] = ch;
+    ch = scannext(scan);
+  }
+  buffer[n] = 0;
+  for (p = buffer; *p; p++)
+    if (isdigit((unsigned char)*p) ||
+        ((*p == '-' || *p == '.') && isdigit((unsigned char)p[1])))
+      break;
+  if (*p) {
+    scan->metrics[k->metric[state]] = parsedecimal(p, buffer + n, 0);
+    msg(2, "found metric '%s' line in '%s'", metrics[k->metric[state]].name,
+        logpath);
+  }
+  if (ch == EOF)
+    goto DONE;
+  goto START;
+UNSAT:
+  assert(ch == '\n');
+  res = 20;
+RESULT:
+  addscanevent(scan, this, res);
+  goto START;
+START_OF_WITNESS:
+  ch = scannext(scan);
+  if (ch == 'c') {
+    while ((ch = scannext(scan)) != '\n')
       if (ch == EOF)
         goto INVALID_WITNESS_SAVECH;
     goto START_OF_WITNESS;
   }
   if (ch != 'b' && ch != 'j')
     goto INVALID_WITNESS_SAVECH;
-  if ((ch = nextch()) != '0')
+  if ((ch = scannext(scan)) != '0')
     goto INVALID_WITNESS_SAVECH;
-  if ((ch = nextch()) != '\n')
+  if ((ch = scannext(scan)) != '\n')
     goto INVALID_WITNESS_SAVECH;
   bnd = -2;
 NEXT_TRACE_LINE:
   assert(ch == '\n');
-  ch = nextch();
+  ch = scannext(scan);
   if (ch == '.')
     goto END_OF_WITNESS;
   if (ch != '0' && ch != '1' && ch != 'x' && ch != '\n')
@@ -1045,7 +2568,7 @@ NEXT_TRACE_LINE:
   if (ch == '\n')
     goto NEXT_TRACE_LINE;
 NEXT_CHAR_IN_TRACE_LINE:
-  ch = nextch();
+  ch = scannext(scan);
   if (ch == '\n')
     goto NEXT_TRACE_LINE;
   if (ch != '0' && ch != '1' && ch != 'x')
@@ -1053,522 +2576,230 @@ NEXT_CHAR_IN_TRACE_LINE:
   goto NEXT_CHAR_IN_TRACE_LINE;
 END_OF_WITNESS:
   assert(ch == '.');
-  ch = nextch();
+  ch = scannext(scan);
   if (ch != '\n') {
-    wrn("no new line after '.' at end of AIGER witness in '%s'", logpath);
+    if (ch == EOF && !scan->last)
+      return;
+    addscanevent(scan, "no new line after '.' at end of AIGER witness in '%s'",
+                 0);
     goto INVALID_WITNESS_NO_SAVECH;
   }
   if (bnd < 0)
     goto INVALID_WITNESS_NO_SAVECH;
   msg(2, "found AIGER witness of length '%d'", bnd);
-  if (e->minsbnd < 0 || e->minsbnd > bnd)
-    e->minsbnd = bnd;
+  if (scan->minsbnd < 0 || scan->minsbnd > bnd)
+    scan->minsbnd = bnd;
   goto SAT;
 INVALID_WITNESS_SAVECH:
-  savech(ch);
+  if (ch == EOF && !scan->last)
+    return;
+  scansave(scan, ch);
 INVALID_WITNESS_NO_SAVECH:
-  wrn("invalid AIGER witness in '%s'", logpath);
+  addscanevent(scan, "invalid AIGER witness in '%s'", 0);
 SAT:
-  e->res = 10;
+  res = 10;
   goto RESULT;
-SEEN_S:
-  assert(ch == 's');
-  ch = nextch();
-  if (isdigit(ch)) {
-    bnd = getposint(ch);
-    if (bnd < 0)
-      goto WAIT;
-    msg(2, "found 's%d' line", bnd);
-    if (e->minsbnd < 0 || e->minsbnd > bnd)
-      e->minsbnd = bnd;
-    goto START;
+DONE:
+  scan->clean = 1;
+}
+
+
+#if !defined(NMMAP) && !defined(NTHREADS)
+
+/* With '--log-threads' log files of at least two chunks are split into
+ * chunks at line boundaries, which are scanned in parallel.  The scanner
+ * is at the start of a line in its initial state, unless it is within an
+ * AIGER witness.  Thus the events of a chunk starting with such a line are
+ * the same as if scanned sequentially.  If a chunk ends within a witness
+ * it is not 'clean' and its events after the start of the witness are
+ * dropped.  Scanning then restarts at the witness and continues to the end
+ * of the next chunk (and so on, until it ends clean).  The merged events
+ * and bounds thus are exactly those of a sequential scan.
+ */
+
+#ifndef MINCHUNK
+#define MINCHUNK (1 << 22)
+#endif
+
+static void *scanthread(void *p) {
+  Scan *scan = p;
+  scanlog(scan, scan->path);
+  return 0;
+}
+
+static void appendscan(Scan *total, Scan *scan) {
+  unsigned i;
+  for (i = 0; i < scan->nevents; i++)
+    addscanevent(total, scan->events[i].text, scan->events[i].res);
+  free(scan->events);
+  if (scan->nomemory)
+    total->nomemory = 1;
+  if (scan->minsbnd >= 0 &&
+      (total->minsbnd < 0 || total->minsbnd > scan->minsbnd))
+    total->minsbnd = scan->minsbnd;
+  if (total->maxubnd < scan->maxubnd)
+    total->maxubnd = scan->maxubnd;
+  if (scan->optimum >= 0)
+    total->optimum = scan->optimum;
+  for (i = 0; i < nmetrics; i++)
+    if (!isnan(scan->metrics[i]))
+      total->metrics[i] = scan->metrics[i];
+  free(scan->metrics);
+}
+
+static int scanchunks(Scan *total, const char *logpath) {
+  const char *start = total->top, *end = total->end, *p, *q, *witness;
+  size_t bytes = end - start;
+  unsigned i, j, n;
+  pthread_t *threads;
+  Scan *scans, rescan;
+  int clean;
+  if (logthreads < 2 || bytes < 2 * (size_t)MINCHUNK)
+    return 0;
+  n = bytes / MINCHUNK;
+  if (n > logthreads)
+    n = logthreads;
+  scans = calloc(n, sizeof *scans);
+  threads = calloc(n, sizeof *threads);
+  if (!scans || !threads)
+    die("out of memory allocating log chunks");
+  for (i = j = 0, p = start; i < n && p < end; i++) {
+    q = i + 1 == n ? end : start + (i + 1) * (bytes / n);
+    if (q < p)
+      q = p;
+    while (q < end && q[-1] != '\n')
+      q++;
+    if (q == p)
+      continue;
+    initscan(scans + j, total->keywords, p, q, q == end);
+    scans[j++].path = logpath;
+    p = q;
   }
-  if (ch == '\n')
-    goto START;
-  if (ch == 'a')
-    goto SEEN_SA;
-  if (ch != ' ')
-    goto WAIT;
-  ch = nextch();
-  if (ch == 'S')
-    goto SEEN_S_S;
-  if (ch == 'U')
-    goto SEEN_S_U;
-  if (ch == 'V')
-    goto SEEN_S_V;
-  if (ch == 'O')
-    goto SEEN_S_O;
-  if (ch == '\n')
-    goto START;
-  goto WAIT;
-SEEN_U:
-  assert(ch == 'u');
-  ch = nextch();
-  if (isdigit(ch)) {
-    bnd = getposint(ch);
-    if (bnd < 0)
-      goto WAIT;
-    msg(2, "found 'u%d' line", bnd);
-    if (e->maxubnd < 0 || e->maxubnd < bnd)
-      e->maxubnd = bnd;
-    goto START;
+  n = j;
+  for (i = 1; i < n; i++)
+    if (pthread_create(threads + i, 0, scanthread, scans + i))
+      die("failed to start thread scanning '%s'", logpath);
+  scanthread(scans);
+  for (i = 1; i < n; i++)
+    pthread_join(threads[i], 0);
+  msg(2, "scanned '%s' in %u chunks", logpath, n);
+  for (i = 0; i < n;) {
+    clean = scans[i].clean || scans[i].last;
+    witness = scans[i].witness;
+    appendscan(total, scans + i++);
+    while (!clean) {
+      assert(i < n);
+      msg(2, "rescanning AIGER witness across chunks of '%s'", logpath);
+      initscan(&rescan, total->keywords, witness, scans[i].end,
+               scans[i].last);
+      free(scans[i].metrics);
+      free(scans[i++].events);
+      scanlog(&rescan, logpath);
+      clean = rescan.clean || rescan.last;
+      witness = rescan.witness;
+      appendscan(total, &rescan);
+    }
   }
-  if (ch == '\n')
-    goto START;
-  if (ch != 'n')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 's')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'a')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 't')
-    goto WAIT;
-  ch = nextch();
-  if (ch != '\n')
-    goto WAIT;
-  this = "unsat";
-  goto UNSAT;
-SEEN_O:
-  assert(ch == 'o');
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != ' ')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (!isdigit(ch))
-    goto WAIT;
-  obnd = getposlong(ch);
-  if (obnd < 0)
-    goto WAIT;
-  msg(2, "found 'o %ld' line in '%s'", obnd, logpath);
-  e->obnd = obnd;
-  goto START;
-SEEN_SA:
-  assert(ch == 'a');
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 't')
-    goto WAIT;
-  ch = nextch();
-  if (ch != '\n')
-    goto WAIT;
-  this = "sat";
-  goto SAT;
-SEEN_S_S:
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'A')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'T')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'I')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'S')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'F')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'I')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'A')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'B')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'L')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'E')
-    goto WAIT;
-  ch = nextch();
-  if (ch != '\n')
-    goto WAIT;
-  this = "s SATISFIABLE";
-  goto SAT;
-SEEN_S_U:
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'N')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'S')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'A')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'T')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'I')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'S')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'F')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'I')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'A')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'B')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'L')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'E')
-    goto WAIT;
-  ch = nextch();
-  if (ch != '\n')
-    goto WAIT;
-  this = "s UNSATISFIABLE";
-  goto UNSAT;
-SEEN_S_V:
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'E')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'R')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'I')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'F')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'I')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'E')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'D')
-    goto WAIT;
-  ch = nextch();
-  if (ch != '\n')
-    goto WAIT;
-  this = "s VERIFIED";
-  goto UNSAT;
-SEEN_S_O:
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'P')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'T')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'I')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'M')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch == 'I') { // TODO remove ...
-    ch = nextch();
-    if (ch == '\n')
-      goto START;
-  }
-  if (ch != 'U')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'M')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != ' ')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'F')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'O')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'U')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'N')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'D')
-    goto WAIT;
-  ch = nextch();
-  if (ch != '\n')
-    goto WAIT;
-  this = "s OPTIMUM FOUND";
-  goto SAT;
-SEEN_C_S:
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'A')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'T')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'I')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'S')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'F')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'I')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'A')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'B')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'L')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'E')
-    goto WAIT;
-  ch = nextch();
-  if (ch != '\n')
-    goto WAIT;
-  this = "SATISFIABLE";
-  goto SAT;
-SEEN_C_U:
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'N')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'S')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'A')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'T')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'I')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'S')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'F')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'I')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'A')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'B')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'L')
-    goto WAIT;
-  ch = nextch();
-  if (ch == '\n')
-    goto START;
-  if (ch != 'E')
-    goto WAIT;
-  ch = nextch();
-  if (ch != '\n')
-    goto WAIT;
-  this = "UNSATISFIABLE";
-  goto UNSAT;
-DONE:
+  free(threads);
+  free(scans);
+  return 1;
+}
+
+#else
+
+static int scanchunks(Scan *total, const char *logpath) {
+  (void)total, (void)logpath;
+  return 0;
+}
+
+#endif
+
+static void parselogfile(Entry *e, const char *logpath,
+                         const Keywords *keywords, double *metricvalues) {
+  int minsbnd, maxubnd;
+  const char *other = 0;
+  unsigned i;
+  Scan scan;
+  assert(!e->res);
+  msg(2, "parsing log file '%s'", logpath);
+  open_input(logpath);
+#ifndef NMMAP
+  initscan(&scan, keywords, input.start, input.end, 1);
+#else
+  initscan(&scan, keywords, 0, 0, 1);
+#endif
+  if (!scanchunks(&scan, logpath))
+    scanlog(&scan, logpath);
   close_input(logpath);
-  assert(found <= 1);
-  if (other)
+  if (scan.nomemory)
+    die("out of memory reallocating log events of '%s'", logpath);
+  for (i = 0; i < scan.nevents; i++) {
+    const char *this = scan.events[i].text;
+    if (!scan.events[i].res) {
+      wrn(this, logpath);
+      continue;
+    }
+    e->res = scan.events[i].res;
+    msg(2, "found '%s' line in '%s'", this, logpath);
+    if (other) {
+      if (strcmp(other, this))
+        die("two different results '%s' and '%s' in '%s'", other, this,
+            logpath);
+      else
+        wrn("two (identical) results '%s' and '%s' in '%s'", other, this,
+            logpath);
+    }
+    other = this;
+  }
+  free(scan.events);
+  if (nmetrics)
+    memcpy(metricvalues, scan.metrics, nmetrics * sizeof *metricvalues);
+  free(scan.metrics);
+  minsbnd = scan.minsbnd;
+  maxubnd = scan.maxubnd;
+  if (scan.optimum >= 0)
+    newoptimum(e, scan.optimum);
+  if (other) {
     assert(e->res == 10 || e->res == 20);
-  else {
+    e->line = LINE_FOUND;
+  } else {
     msg(2, "no proper sat/unsat line found in '%s'", logpath);
-    if (just) {
-      msg(2, "'--just'' option forces UNSAT result '%s'", logpath);
-      e->res = 20;
-    }
+    e->line = LINE_MISSING;
     assert(!e->res);
   }
-  if (e->minsbnd >= 0)
-    msg(2, "found minimum sat-bound 's%d' in '%s'", e->minsbnd, logpath);
-  if (e->maxubnd >= 0)
-    msg(2, "found maximum unsat-bound 'u%d'", e->maxubnd, logpath);
+  if (minsbnd >= 0)
+    msg(2, "found minimum sat-bound 's%d' in '%s'", minsbnd, logpath);
+  if (maxubnd >= 0)
+    msg(2, "found maximum unsat-bound 'u%d'", maxubnd, logpath);
 
-  if (e->minsbnd >= 0 && e->minsbnd <= e->maxubnd) {
-    wrn("minimum sat-bound %d <= maximum unsat-bound %d in '%s'", e->minsbnd,
-        e->maxubnd, logpath);
-    wrn("ignoring maximum unsat-bound %d in '%s'", e->maxubnd, logpath);
-    e->maxubnd = -1;
+  if (minsbnd >= 0 && minsbnd <= maxubnd) {
+    wrn("minimum sat-bound %d <= maximum unsat-bound %d in '%s'", minsbnd,
+        maxubnd, logpath);
+    wrn("ignoring maximum unsat-bound %d in '%s'", maxubnd, logpath);
+    maxubnd = -1;
     setubndbroken(e, UBND_LOCALLY_BROKEN);
   }
 
-  if (e->minsbnd >= 0 && e->res == 20)
-    die("minimum sat-bound %d and with unsat result line in '%s'", e->minsbnd,
+  if (minsbnd >= 0 && e->res == 20)
+    die("minimum sat-bound %d and with unsat result line in '%s'", minsbnd,
         logpath);
 
-  if (e->minsbnd >= 0 && e->res != 10) {
+  if (minsbnd >= 0 && e->res != 10) {
     assert(!e->res);
     wrn("minimum sat-bound %d and no result line found in '%s' (forcing sat)",
-        e->minsbnd, logpath);
+        minsbnd, logpath);
     e->res = 10;
   }
 
   assert(e->bnd < 0);
-  if (e->minsbnd >= 0) {
+  if (minsbnd >= 0) {
     assert(e->res == 10);
-    e->bnd = e->minsbnd;
-  } else if (e->maxubnd >= 0) {
+    e->bnd = minsbnd;
+  } else if (maxubnd >= 0) {
     if (e->res)
       assert(e->res == 10 || e->res == 20);
     else
-      e->bnd = e->maxubnd;
+      e->bnd = maxubnd;
   }
 }
 
@@ -1596,312 +2827,1856 @@ static int cmp_entry_better(Entry *, Entry *);
 #define GLOBAL_ZUMMARY_DO_NOT_HAVE_BEST 1
 #define GLOBAL_ZUMMARY_HAVE_BEST 2
 
-static void fixzummary(Zummary *z, int zummary_mode) {
-  Entry *e;
+static void forcelimits(Zummary *);
+
+static void startfix(Zummary *z, int zummary_mode) {
+  if (nmetrics) {
+    free(z->metrics);
+    if (!(z->metrics = calloc(nmetrics, sizeof *z->metrics)))
+      die("out of memory allocating metric sums");
+  }
   z->cnt = z->sol = z->sat = z->uns = z->dis = 0;
   z->fld = z->tio = z->meo = z->s11 = z->si6 = z->unk = 0;
   z->wll = z->tim = z->mem = z->max = 0;
   z->bnd = z->bst = z->unq = 0;
+  if (zummary_mode != LOCAL_ZUMMARY)
+    forcelimits(z);
+}
+
+/* Zummaries keep the limits of the error files.  The forced limits replace
+ * them only in memory and before any entry is checked against them.
+ */
+static void forcelimits(Zummary *z) {
   if (forced_real_limit >= 0 && z->rlim > forced_real_limit) {
     msg(1, "replacing real time limit of '%s' by '%d'", z->path,
         forced_real_limit);
     z->rlim = forced_real_limit;
   }
-  if (forced_time_limit >= 0 && z->tlim > forced_time_limit) {
-    msg(1, "replacing time limit of '%s' by '%d'", z->path, forced_time_limit);
-    z->tlim = forced_time_limit;
+  if (forced_time_limit >= 0 && z->tlim > forced_time_limit) {
+    msg(1, "replacing time limit of '%s' by '%d'", z->path, forced_time_limit);
+    z->tlim = forced_time_limit;
+  }
+}
+
+/* Results of entries exceeding the limits are not trusted.  The zummary
+ * files keep these results, such that they can be checked against forced
+ * limits later, which happens while analyzing before discrepancies are
+ * determined (see 'fixalllimits').  Time-outs and memory-outs reported by
+ * 'runlim' are kept, even if a result was printed.
+ */
+static void fixlimits(Zummary *z, Entry *e) {
+  if (e->res < 10 || e->tio || e->meo)
+    return;
+  assert(e->res == 10 || e->res == 20);
+  if (TIM(e) > z->tlim) {
+    msg(1, "error file '%s/%s.err' actually exceeds time limit", z->path,
+        NAME(e));
+    e->tio = 1, e->res = 1;
+  } else if (WLL(e) > z->rlim) {
+    msg(1, "error file '%s/%s.err' actually exceeds real time limit", z->path,
+        NAME(e));
+    e->tio = 1, e->res = 1;
+  } else if (MEM(e) > z->slim) {
+    msg(1, "error file '%s/%s.err' actually exceeds space limit", z->path,
+        NAME(e));
+    e->meo = 1, e->res = 2;
+  }
+}
+
+static void fixalllimits() {
+  unsigned i;
+  Zummary *z;
+  int j;
+  for (j = 0; j < nzummaries; j++) {
+    z = zummaries[j];
+    forcelimits(z);
+    for (i = z->first; i < z->last; i++)
+      fixlimits(z, ENTRY(i));
+  }
+}
+
+/* Determines the final status code 'e->res' of an entry.  Applying it
+ * twice does not change anything, which allows to classify entries again
+ * even if they are not counted in 'countentry' later.
+ */
+static void fixentry(Zummary *z, Entry *e, int zummary_mode) {
+  assert(!e->tio + !e->meo + !e->unk >= 2);
+  if (e->dis)
+    assert(zummary_mode != LOCAL_ZUMMARY), e->res = 4;
+  else if (e->s11)
+    e->res = 5;
+  else if (e->si6)
+    e->res = 6;
+  else if (e->tio)
+    e->res = 1;
+  else if (e->meo)
+    e->res = 2;
+  else if (e->res != 10 && e->res != 20)
+    e->unk = 1, e->res = 3;
+  assert(e->res);
+  if (z->ubndbroken && e->bnd >= 0 && e->res != 10) {
+    if (z->ubndbroken == UBND_GLOBALLY_BROKEN)
+      assert(zummary_mode != LOCAL_ZUMMARY);
+    e->bnd = -1;
+  }
+}
+
+/* Returns zero if the entry is filtered out by '--sat', '--unsat' or
+ * '--deep'.
+ */
+static int projected(Entry *e) {
+  Entry *best = entry(SYMBOL(e)->best);
+  if (satonly && (!best || best->res != 10))
+    return 0;
+  if (unsatonly && (!best || best->res != 20))
+    return 0;
+  if (deeponly) {
+    if (best) {
+      if (best->res == 10)
+        return 0;
+      if (best->res == 20)
+        return 0;
+    }
+  }
+  return 1;
+}
+
+static int countentry(Zummary *z, Entry *e, int zummary_mode) {
+  Entry *best;
+  if (zummary_mode == GLOBAL_ZUMMARY_HAVE_BEST) {
+    if (!projected(e))
+      return 0;
+    best = entry(SYMBOL(e)->best);
+    if (best == e || (best && !cmp_entry_better(e, best))) {
+      assert(!e->dis);
+      z->bst++;
+      assert((SYMBOL(e)->sat > 0) + (SYMBOL(e)->uns > 0) < 2);
+      if ((e->res == 10 && SYMBOL(e)->sat == 1) ||
+          (e->res == 20 && SYMBOL(e)->uns == 1)) {
+        msg(2, "unique (SOTA) '%s/%s'", z->path, NAME(e));
+        z->unq++;
+      }
+    }
+  }
+  z->cnt++;
+  switch (e->res) {
+  case 1:
+    z->tio++;
+    break;
+  case 2:
+    z->meo++;
+    break;
+  case 3:
+    z->unk++;
+    break;
+  case 4:
+    z->dis++;
+    break;
+  case 5:
+    z->s11++;
+    break;
+  case 6:
+    z->si6++;
+    break;
+  case 10:
+    z->sat++;
+    break;
+  default:
+    assert(e->res == 20);
+    z->uns++;
+    break;
+  }
+  if (e->res == 10 || e->res == 20) {
+    z->tim += TIM(e), z->wll += WLL(e), z->mem += MEM(e);
+    if (MEM(e) > z->max)
+      z->max = MEM(e);
+  }
+  if (e->bnd >= 0 && e->res != 4)
+    z->bnd++;
+  return 1;
+}
+
+static void finishfix(Zummary *z, int zummary_mode) {
+  z->sol = z->sat + z->uns;
+  z->fld = z->tio + z->meo + z->s11 + z->si6 + z->unk;
+  assert(z->cnt == z->sol + z->fld + z->dis);
+  if (par) {
+    if (usereal)
+      z->par = z->wll + par * z->rlim * z->fld;
+    else
+      z->par = z->tim + par * z->tlim * z->fld;
+  }
+  if (zummary_mode != LOCAL_ZUMMARY)
+    z->only_use_for_reporting_and_do_not_write = 1;
+}
+
+static void fixzummary(Zummary *z, int zummary_mode) {
+  unsigned i, j;
+  startfix(z, zummary_mode);
+  if (zummary_mode != LOCAL_ZUMMARY)
+    for (i = z->first; i < z->last; i++)
+      fixlimits(z, ENTRY(i));
+  for (i = z->first; i < z->last; i++) {
+    Entry *e = ENTRY(i);
+    fixentry(z, e, zummary_mode);
+    if (countentry(z, e, zummary_mode) && (e->res == 10 || e->res == 20))
+      for (j = 0; j < nmetrics; j++)
+        if (!isnan(VALUE(i, j)))
+          z->metrics[j] += VALUE(i, j);
+  }
+  finishfix(z, zummary_mode);
+}
+
+/* A 'lazy' header marks files where some log files were not parsed (see
+ * 'skiplog'), which then have bound '-2' instead of '-1'.  It might be
+ * followed by a 'keywords:<hash>' marker (see 'keywordshash').  The names
+ * of the 'line', 'optimum' and metric columns follow, which always come
+ * after a bound column.
+ */
+static int iszummaryheader(const Span *t, int n) {
+  return n >= 7 && isspan(t[0], "result") && isspan(t[1], "time") &&
+         isspan(t[2], "real") && isspan(t[3], "space") &&
+         isspan(t[4], "tlim") && isspan(t[5], "rlim") &&
+         isspan(t[6], "slim") && (n == 7 || isspan(t[7], "bound"));
+}
+
+static int firstmetricheader(const Span *t, int n) {
+  int res = 8;
+  if (res < n && isspan(t[res], "lazy"))
+    res++;
+  if (res < n && t[res].size > 9 && !memcmp(t[res].start, "keywords:", 9))
+    res++;
+  return res;
+}
+
+/* Returns the token index of the column 'name' in lines following the
+ * header 't[0]', ..., 't[n-1]' or '-1' if it is missing.  The 'line'
+ * column comes first after the bound column and before metric columns.
+ */
+static int namedcolumn(const Span *t, int n, const char *name) {
+  int i, first = firstmetricheader(t, n);
+  for (i = first; i < n; i++)
+    if (isspan(t[i], name))
+      return 9 + i - first;
+  return -1;
+}
+
+static int metriccolumn(const Span *t, int n, unsigned j) {
+  return namedcolumn(t, n, metrics[j].name);
+}
+
+/* The 'line' column gives '1' if a result line was found in the log file,
+ * '0' if not and '-1' if the log file was not parsed.
+ */
+static unsigned spanline(Span t, const char *path) {
+  int line = spaninteger(t);
+  if (line < -1 || line > 1)
+    die("invalid result line flag in '%s'", path);
+  return line + 1;
+}
+
+/* Zummaries keep what was found in the error and log files, independent of
+ * the options '--just' and '--no-bounds', which are applied after loading
+ * or writing a zummary, as well as '--forced-time-limit' and
+ * '--forced-real-limit' (see 'fixlimits').  Zummaries without 'line'
+ * column were either written by previous versions, maybe with these
+ * options, or did not need it (see 'needslines').  They are still used,
+ * unless '--just' needs the column.
+ */
+static void applyparseoptions(Entry *e) {
+  if (nobounds && e->bnd >= 0)
+    e->bnd = -1;
+  if (!just || e->line != LINE_MISSING || e->res == 10)
+    return;
+  e->bnd = -1;
+  if (e->tio || e->meo || e->s11 || e->si6)
+    return;
+  msg(2, "'--just' option forces UNSAT result of '%s'", NAME(e));
+  e->res = 20;
+  e->unk = 0;
+}
+
+/* The 'line' column is only written if '--just' would change an entry as
+ * above, or if '--just' is given, since zummaries without it are updated
+ * with '--just'.  The former already holds for any unknown result without
+ * status line, thus most zummaries have this column.  This changes the
+ * cache format and older versions fail to read such zummaries (as those
+ * with any other of the optional columns).
+ */
+static int needslines(Zummary *z) {
+  unsigned i;
+  Entry *e;
+  if (just)
+    return 1;
+  for (i = z->first; i < z->last; i++) {
+    e = ENTRY(i);
+    if (e->line != LINE_MISSING || e->res == 10)
+      continue;
+    if (e->bnd >= 0 || !(e->tio || e->meo || e->s11 || e->si6))
+      return 1;
+  }
+  return 0;
+}
+
+/* Fills in the entry from the tokens 't[1]', ..., 't[n-1]' of a line of a
+ * 'zummary' file (the name 't[0]' has already been used to create 'e').
+ */
+static void parsezummaryentry(Zummary *z, Entry *e, const Span *t, int n,
+                              const char *path) {
+  double tlim, rlim, slim;
+  e->res = spaninteger(t[1]);
+  e->tim = centi(spandecimal(t[2]));
+  e->wll = centi(spandecimal(t[3]));
+  e->mem = deci(spandecimal(t[4]));
+  tlim = spandecimal(t[5]);
+  if (tlim <= 0)
+    die("invalid time limit %.0f in '%s'", tlim, path);
+  if (z->tlim < 0) {
+    msg(1, "setting time limit of '%s' to %.0f", z->path, tlim);
+    z->tlim = tlim;
+  } else if (!ignore && z->tlim != tlim)
+    wrn("different time limit %.0f in '%s'", tlim, path);
+  rlim = spandecimal(t[6]);
+  if (rlim <= 0)
+    die("invalid real time limit %.0f in '%s'", rlim, path);
+  if (z->rlim < 0) {
+    msg(1, "setting real time limit of '%s' to %.0f", z->path, rlim);
+    z->rlim = rlim;
+  } else if (!ignore && z->rlim != rlim)
+    wrn("different real time limit %.0f in '%s'", rlim, path);
+  slim = spandecimal(t[7]);
+  if (slim <= 0)
+    die("invalid space limit %.0f in '%s'", slim, path);
+  if (z->slim < 0) {
+    msg(1, "setting space limit of '%s' to %.0f", z->path, slim);
+    z->slim = slim;
+  } else if (!ignore && z->slim != slim)
+    wrn("different space limit %.0f in '%s'", slim, path);
+  if (n < 9 || (e->bnd = spandecimal(t[8])) < 0) {
+    if (e->bnd == -2)
+      e->lzy = 1, z->lazy++;
+    e->bnd = -1;
+  }
+  if (n >= 9)
+    msg(2, "loaded %s %d %.2f %.2f %.1f %.2f %.2f %.1f %d", NAME(e), e->res,
+        TIM(e), WLL(e), MEM(e), tlim, rlim, slim, e->bnd);
+  else
+    msg(2, "loaded %s %d %.2f %.2f %.1f %.2f %.2f %.1f", NAME(e), e->res,
+        TIM(e), WLL(e), MEM(e), tlim, rlim, slim);
+  if (e->res != 10 && e->res != 20) {
+    assert(e->res != 4);
+    if (e->res == 1)
+      e->tio = 1;
+    if (e->res == 2)
+      e->meo = 1;
+    else if (e->res == 3)
+      e->unk = 1;
+    else if (e->res == 4)
+      e->dis = 1; // TODO remove?
+    else if (e->res == 5)
+      e->s11 = 1;
+    else if (e->res == 6)
+      e->si6 = 1;
+  }
+}
+
+static void loadzummary(Zummary *z, const char *path) {
+  int first = 1, maxtokens = 9, *columns = 0, column, line = -1;
+  int optimum = -1;
+  unsigned j;
+  Entry *e;
+  long obnd;
+  assert(!z->cnt);
+  msg(1, "trying to load zummary '%s'", path);
+  open_input(path);
+  lineno = 1;
+  while (parsezummaryline()) {
+    if (!first) {
+      if (ntokens < 8 || ntokens > maxtokens)
+        die("invalid line in '%s'", path);
+      if (!selected(tokens[0].start, tokens[0].size))
+        continue;
+      e = newentry(z, tokens[0].start, tokens[0].size);
+      parsezummaryentry(z, e, tokens, ntokens, path);
+      if (line >= 0 && line < ntokens)
+        e->line = spanline(tokens[line], path);
+      if (optimum >= 0 && optimum < ntokens &&
+          (obnd = spandecimal(tokens[optimum])) >= 0)
+        newoptimum(e, obnd);
+      applyparseoptions(e);
+      for (j = 0; j < nmetrics; j++)
+        if ((column = columns[j]) >= 0 && column < ntokens &&
+            !isspan(tokens[column], "-"))
+          VALUE(z->last - 1, j) = spandecimal(tokens[column]);
+    } else if (!iszummaryheader(tokens, ntokens))
+      die("invalid header in '%s'", path);
+    else {
+      if (ntokens > firstmetricheader(tokens, ntokens))
+        maxtokens += ntokens - firstmetricheader(tokens, ntokens);
+      if (nmetrics && !(columns = malloc(nmetrics * sizeof *columns)))
+        die("out of memory allocating metric columns");
+      for (j = 0; j < nmetrics; j++)
+        columns[j] = metriccolumn(tokens, ntokens, j);
+      line = namedcolumn(tokens, ntokens, "line");
+      optimum = namedcolumn(tokens, ntokens, "optimum");
+      first = 0;
+    }
+  }
+  free(columns);
+  msg(1, "loaded %d entries from '%s'", z->cnt, path);
+  close_input(path);
+  sortzummary(z);
+  loaded++;
+}
+
+static double wallclock() {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts))
+    return 0;
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static void recordparsed(Zummary *z, const char *path, double seconds) {
+  Parsed *p;
+  if (nparsed == sizeparsed) {
+    int newsizeparsed = sizeparsed ? 2 * sizeparsed : 1;
+    parsed = realloc(parsed, newsizeparsed * sizeof *parsed);
+    if (!parsed)
+      die("out of memory reallocating parsed files stack");
+    sizeparsed = newsizeparsed;
+  }
+  p = parsed + nparsed++;
+  p->path = strdup(path);
+  if (!p->path)
+    die("out of memory copying parsed file path");
+  p->zummary = z;
+  p->seconds = seconds;
+  p->bytes = file_size(path);
+}
+
+static int boundsneeded() {
+  int i;
+  if (nobounds)
+    return 0;
+  if (deeponly)
+    return 1;
+  for (i = 0; i < nreports; i++)
+    if (reports[i].deeponly)
+      return 1;
+  return 0;
+}
+
+/* The result of runs which 'runlim' classified as time-out, memory-out or
+ * crash does not depend on the log file, which then is only needed for
+ * bounds.  These log files are usually the largest ones, so with '--lazy'
+ * they are not parsed unless bounds are needed.
+ */
+static int skiplog(Zummary *z, Entry *e) {
+  if (!lazy || boundsneeded())
+    return 0;
+  if (!e->tio && !e->meo && !e->s11 && !e->si6)
+    return 0;
+  msg(2, "skipping log of '%s/%s'", z->path, NAME(e));
+  e->lzy = 1;
+  z->lazy++;
+  return 1;
+}
+
+/* Sample series are stored in 'samplebytes' as the number of samples
+ * followed by the differences of consecutive times and spaces, which are
+ * small and thus encoded as zig-zag variable length integers.  Usually
+ * this takes two bytes per sample.  Offset zero denotes no samples.
+ */
+static void pushsamplebyte(unsigned char byte) {
+  if (nsamplebytes == sizesamplebytes) {
+    size_t newsize = sizesamplebytes ? 2 * sizesamplebytes : 1 << 12;
+    samplebytes = realloc(samplebytes, newsize);
+    if (!samplebytes)
+      die("out of memory reallocating sample bytes");
+    sizesamplebytes = newsize;
+  }
+  samplebytes[nsamplebytes++] = byte;
+}
+
+static void pushvarint(unsigned long long u) {
+  while (u > 127) {
+    pushsamplebyte(128 | (u & 127));
+    u >>= 7;
+  }
+  pushsamplebyte(u);
+}
+
+static unsigned long long zigzag(long long delta) {
+  return delta < 0 ? 2 * (unsigned long long)-delta - 1
+                   : 2 * (unsigned long long)delta;
+}
+
+static long long unzigzag(unsigned long long u) {
+  return u & 1 ? -(long long)(u >> 1) - 1 : (long long)(u >> 1);
+}
+
+static int hassamples(unsigned idx) {
+  return idx < sizesampleoffsets && sampleoffsets[idx];
+}
+
+static void storesamples(unsigned idx) {
+  long long time = 0, space = 0;
+  unsigned i;
+  if (!nsampled) {
+    sampleoffsets[idx] = 0;
+    return;
+  }
+  if (!nsamplebytes)
+    pushsamplebyte(0);
+  sampleoffsets[idx] = nsamplebytes;
+  pushvarint(nsampled / 2);
+  for (i = 0; i < nsampled; i += 2) {
+    pushvarint(zigzag(sampled[i] - time));
+    pushvarint(zigzag(sampled[i + 1] - space));
+    time = sampled[i], space = sampled[i + 1];
+  }
+}
+
+/* Reads a variable length integer and returns the number of its bytes or
+ * zero if it is truncated.
+ */
+static size_t getvarint(const unsigned char *p, const unsigned char *end,
+                        unsigned long long *uptr) {
+  unsigned long long u = 0;
+  const unsigned char *q;
+  unsigned shift = 0;
+  for (q = p; q < end && shift < 64; q++, shift += 7) {
+    u |= (unsigned long long)(*q & 127) << shift;
+    if (!(*q & 128)) {
+      *uptr = u;
+      return q - p + 1;
+    }
+  }
+  return 0;
+}
+
+/* Returns the number of bytes of the encoded series or zero if invalid.
+ */
+static size_t samplesize(const unsigned char *p, const unsigned char *end) {
+  unsigned long long n, u;
+  size_t size, bytes;
+  if (!(size = getvarint(p, end, &n)) || n > (size_t)(end - p))
+    return 0;
+  for (n *= 2; n--; size += bytes)
+    if (!(bytes = getvarint(p + size, end, &u)))
+      return 0;
+  return size;
+}
+
+/* Decodes the samples of the entry with index 'idx' into 'sampled' and
+ * returns the number of samples.
+ */
+static unsigned decodesamples(unsigned idx) {
+  const unsigned char *p, *end = samplebytes + nsamplebytes;
+  unsigned long long n = 0, u = 0;
+  long long time = 0, space = 0;
+  nsampled = 0;
+  if (!hassamples(idx))
+    return 0;
+  p = samplebytes + sampleoffsets[idx];
+  p += getvarint(p, end, &n);
+  while (n--) {
+    p += getvarint(p, end, &u);
+    time += unzigzag(u);
+    p += getvarint(p, end, &u);
+    space += unzigzag(u);
+    addsample(time, space);
+  }
+  return nsampled / 2;
+}
+
+static void updatepair(Zummary *z, Keywords *k, const char *base) {
+  char *logname = appendstr(base, ".log");
+  char *logpath = appendpath(z->path, logname);
+  Entry *e;
+  if (isfile(logpath)) {
+    char *errname = appendstr(base, ".err");
+    char *errpath = appendpath(z->path, errname);
+    double *v;
+    e = newentry(z, base, strlen(base));
+    v = nmetrics ? &VALUE(z->last - 1, 0) : 0;
+    assert(isfile(errpath));
+    if (slow) {
+      double start = wallclock();
+      int ok = parserrfile(e, errpath);
+      recordparsed(z, errpath, wallclock() - start);
+      if (ok && !skiplog(z, e)) {
+        start = wallclock();
+        parselogfile(e, logpath, k, v);
+        recordparsed(z, logpath, wallclock() - start);
+      }
+    } else if (parserrfile(e, errpath) && !skiplog(z, e))
+      parselogfile(e, logpath, k, v);
+    if (samples)
+      storesamples(z->last - 1);
+    free(errpath);
+    free(errname);
+    assert(!e->res || e->res == 10 || e->res == 20);
+    if (e->tio && e->res)
+      wrn("result %d with time-out in '%s/%s'", e->res, z->path, base);
+    if (e->meo && e->res)
+      wrn("result %d with memory-out in '%s/%s'", e->res, z->path, base);
+    if (e->s11 && e->res)
+      wrn("result %d with 'segmentation fault' in '%s/%s'", e->res, z->path,
+          base);
+    if (e->s11 && e->res)
+      wrn("result %d with 'segmentation fault' (s11) in '%s/%s'", e->res,
+          z->path, base);
+    if (e->si6 && e->res)
+      wrn("result %d with 'abort signal' (s6) in '%s/%s'", e->res, z->path,
+          base);
+    if (e->unk && e->res)
+      wrn("result %d and unknown status in '%s/%s'", e->res, z->path, base);
+  } else
+    msg(1, "missing '%s'", logpath);
+  free(logpath);
+  free(logname);
+}
+
+/* On archives with cold caches reading files in 'readdir' order, which is
+ * hash order on most file systems, makes the disk seek for every file.
+ * With '--inode-order' all pairs are collected first and then parsed in
+ * the order of the inode numbers of their error files, which is close to
+ * the order in which they were created and thus laid out on the disk.
+ * Further, reading the files 'PREFETCH' pairs ahead is requested from the
+ * kernel, which then reads them while the current pair is parsed.
+ */
+
+#ifndef PREFETCH
+#define PREFETCH 16
+#endif
+
+static int cmppair4qsort(const void *p, const void *q) {
+  const Pair *a = p, *b = q;
+  if (a->ino < b->ino)
+    return -1;
+  if (a->ino > b->ino)
+    return 1;
+  return strcmp(a->base, b->base);
+}
+
+static void prefetchfile(Zummary *z, const char *base, const char *suffix) {
+#ifdef POSIX_FADV_WILLNEED
+  char *name = appendstr(base, suffix), *path = appendpath(z->path, name);
+  int fd = open(path, O_RDONLY);
+  if (fd >= 0) {
+    (void)posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+  }
+  free(path);
+  free(name);
+#else
+  (void)z, (void)base, (void)suffix;
+#endif
+}
+
+static void updatepairs(Zummary *z, Keywords *k, Pair *pairs, unsigned n) {
+  unsigned i, j = 0;
+  qsort(pairs, n, sizeof *pairs, cmppair4qsort);
+  msg(1, "parsing %u pairs of '%s' in inode order", n, z->path);
+  for (i = 0; i < n; i++) {
+    for (; j < n && j <= i + PREFETCH; j++) {
+      prefetchfile(z, pairs[j].base, ".err");
+      prefetchfile(z, pairs[j].base, ".log");
+    }
+    updatepair(z, k, pairs[i].base);
+    free(pairs[i].base);
+  }
+}
+
+static void updatezummary(Zummary *z) {
+  Keywords *k = directorykeywords(z);
+  unsigned npairs = 0, sizepairs = 0;
+  struct dirent *dirent;
+  Pair *pairs = 0;
+  DIR *dir;
+  msg(1, "updating zummary for directory '%s'", z->path);
+  if (!(dir = open_directory(z->path)))
+    die("can not open directory '%s' for updating", z->path);
+  z->cnt = 0;
+  while ((dirent = readdir(dir))) {
+    const char *errname = dirent->d_name;
+    char *base;
+    msg(2, "checking '%s'", errname);
+    if (!(base = stripsuffix(errname, ".err"))) {
+      msg(2, "skipping '%s'", errname);
+      continue;
+    }
+    if (!selected(base, strlen(base))) {
+      free(base);
+      continue;
+    }
+    if (!inodeorder) {
+      updatepair(z, k, base);
+      free(base);
+      continue;
+    }
+    if (npairs == sizepairs) {
+      sizepairs = sizepairs ? 2 * sizepairs : 64;
+      pairs = realloc(pairs, sizepairs * sizeof *pairs);
+      if (!pairs)
+        die("out of memory reallocating pairs");
+    }
+    pairs[npairs].base = base;
+    pairs[npairs].ino = dirent->d_ino;
+    npairs++;
+  }
+  if (inodeorder)
+    updatepairs(z, k, pairs, npairs);
+  free(pairs);
+  close_directory();
+  if (k != keywords)
+    deletekeywords(k);
+  msg(1, "found %d entries in '%s'", z->cnt, z->path);
+  if (z->lazy)
+    msg(1, "skipped %d log files in '%s'", z->lazy, z->path);
+  if (z->cnt) {
+    if (z->tlim < 0)
+      die("no time limit in '%s'", z->path);
+    if (z->rlim < 0)
+      die("no real time limit in '%s'", z->path);
+    if (z->slim < 0)
+      die("no space limit in '%s'", z->path);
+    if (nzummaries > 1 && z->cnt) {
+      if (!ignore && z->tlim != zummaries[0]->tlim)
+        wrn("different time limit '%.0f' in '%s'", z->tlim, z->path);
+      if (!ignore && z->rlim != zummaries[0]->rlim)
+        wrn("different real time limit '%.0f' in '%s'", z->rlim, z->path);
+      if (!ignore && z->slim != zummaries[0]->slim)
+        wrn("different space limit '%.0f' in '%s'", z->slim, z->path);
+    }
+  }
+  sortzummary(z);
+  updated++;
+}
+
+/*------------------------------------------------------------------------*/
+
+/* Large outputs, i.e., zummaries, merged reports and JSON, are formatted
+ * into the buffer of a writer instead of going through 'fprintf' for each
+ * field.  Only '%.15g' is still formatted by 'snprintf'.
+ */
+
+static Writer output, cache;
+
+static void writeflush(Writer *w) {
+  FILE *file = w->file ? w->file : stdout;
+  if (w->size && fwrite(w->buffer, w->size, 1, file) != 1)
+    die("failed to write output");
+  w->size = 0;
+}
+
+static void writebytes(Writer *w, const char *bytes, size_t n) {
+  if (w->size + n > sizeof w->buffer) {
+    writeflush(w);
+    if (n > sizeof w->buffer) {
+      if (fwrite(bytes, n, 1, w->file ? w->file : stdout) != 1)
+        die("failed to write output");
+      return;
+    }
+  }
+  memcpy(w->buffer + w->size, bytes, n);
+  w->size += n;
+}
+
+static void writechar(Writer *w, char ch) {
+  if (w->size == sizeof w->buffer)
+    writeflush(w);
+  w->buffer[w->size++] = ch;
+}
+
+static void writestr(Writer *w, const char *str) {
+  writebytes(w, str, strlen(str));
+}
+
+static void writeunsigned(Writer *w, unsigned long long u) {
+  char digits[24], *p = digits + sizeof digits;
+  do
+    *--p = '0' + u % 10;
+  while (u /= 10);
+  writebytes(w, p, digits + sizeof digits - p);
+}
+
+static void writeint(Writer *w, long long i) {
+  if (i < 0) {
+    writechar(w, '-');
+    writeunsigned(w, -(unsigned long long)i);
+  } else
+    writeunsigned(w, i);
+}
+
+/* Same as '%.<decimals>f' of 'printf'.  The scaled value is rounded
+ * directly unless it is close to a tie (or large), where 'snprintf' is
+ * needed to round as 'printf' does.  Values stored in centi-seconds or
+ * tenths of mega-bytes are never close to a tie.
+ */
+static void writefixed(Writer *w, double d, int decimals) {
+  unsigned long long scale = 1, u = 0, fraction;
+  double scaled, error = 1;
+  char digits[32];
+  int i;
+  assert(0 <= decimals && decimals < 10);
+  for (i = 0; i < decimals; i++)
+    scale *= 10;
+  scaled = (d < 0 ? -d : d) * scale;
+  if (scaled < 1e15)
+    u = scaled + 0.5, error = scaled - u;
+  if (error > 0.49 || error < -0.49) {
+    i = snprintf(digits, sizeof digits, "%.*f", decimals, d);
+    if (i < 0 || i >= (int)sizeof digits) {
+      writeflush(w);
+      fprintf(w->file ? w->file : stdout, "%.*f", decimals, d);
+    } else
+      writebytes(w, digits, i);
+    return;
+  }
+  if (signbit(d))
+    writechar(w, '-');
+  writeunsigned(w, u / scale);
+  if (!decimals)
+    return;
+  writechar(w, '.');
+  for (fraction = u % scale, i = decimals; i--; fraction /= 10)
+    digits[i] = '0' + fraction % 10;
+  writebytes(w, digits, decimals);
+}
+
+static void writedouble(Writer *w, double d) {
+  char digits[32];
+  int n = snprintf(digits, sizeof digits, "%.15g", d);
+  writebytes(w, digits, n);
+}
+
+/* Cache files are written to a temporary file next to them, which then is
+ * renamed, such that concurrent readers never see a partially written
+ * file.
+ */
+static char *opencache(const char *path) {
+  char *tmp = malloc(strlen(path) + 32);
+  if (!tmp)
+    die("out of memory allocating temporary path");
+  sprintf(tmp, "%s.tmp%ld", path, (long)getpid());
+  assert(!cache.file);
+  if (!(cache.file = fopen(tmp, "w")))
+    die("can not write '%s'", tmp);
+  cache.size = 0;
+  return tmp;
+}
+
+static void closecache(char *tmp, const char *path) {
+  int failed;
+  writeflush(&cache);
+  failed = fclose(cache.file);
+  cache.file = 0;
+  if (failed) {
+    unlink(tmp);
+    die("failed to write '%s'", tmp);
+  }
+  if (rename(tmp, path)) {
+    unlink(tmp);
+    die("failed to rename '%s' to '%s'", tmp, path);
+  }
+  free(tmp);
+}
+
+static void writezummary(Zummary *z, const char *path) {
+  Writer *w = &cache;
+  unsigned long long hash = keywordshash(z);
+  int n, lines, optimum;
+  char limits[128], *tmp;
+  unsigned i, j;
+  Entry *e;
+  assert(!z->only_use_for_reporting_and_do_not_write);
+  tmp = opencache(path);
+  writestr(w, " result time real space tlim rlim slim bound");
+  if (z->lazy)
+    writestr(w, " lazy");
+  if (hash) {
+    writestr(w, " keywords:");
+    writeunsigned(w, hash);
+  }
+  if ((lines = needslines(z)))
+    writestr(w, " line");
+  if ((optimum = hasoptima(z))) {
+    if (noptima)
+      qsort(optima, noptima, sizeof *optima, cmpoptima4qsort);
+    writestr(w, " optimum");
+  }
+  for (j = 0; j < nmetrics; j++) {
+    writechar(w, ' ');
+    writestr(w, metrics[j].name);
+  }
+  writechar(w, '\n');
+  n = snprintf(limits, sizeof limits, " %.0f %.0f %.0f", z->tlim, z->rlim,
+               z->slim);
+  assert(0 < n && n < (int)sizeof limits);
+  for (i = z->first; i < z->last; i++) {
+    e = ENTRY(i);
+    writestr(w, NAME(e));
+    writechar(w, ' ');
+    writeint(w, e->res);
+    writechar(w, ' ');
+    writefixed(w, TIM(e), 2);
+    writechar(w, ' ');
+    writefixed(w, WLL(e), 2);
+    writechar(w, ' ');
+    writefixed(w, MEM(e), 1);
+    writebytes(w, limits, n);
+    writechar(w, ' ');
+    writeint(w, e->lzy ? -2 : e->bnd);
+    if (lines) {
+      writechar(w, ' ');
+      writeint(w, (int)e->line - 1);
+    }
+    if (optimum) {
+      writechar(w, ' ');
+      writeint(w, getoptimum(e));
+    }
+    for (j = 0; j < nmetrics; j++)
+      if (isnan(VALUE(i, j)))
+        writebytes(w, " -", 2);
+      else {
+        writechar(w, ' ');
+        writedouble(w, VALUE(i, j));
+      }
+    writechar(w, '\n');
+  }
+  closecache(tmp, path);
+  msg(1, "written %d entries to zummary '%s'", z->cnt, path);
+  written++;
+}
+
+/* The sample series of the entries of a zummary are cached next to it in
+ * '<dir>/samples', sorted by name as the zummary and only for entries with
+ * samples:
+ *
+ *   "ZUMSMPL1" ( <name> 0 <size> <series> )*
+ *
+ * where '<size>' is the number of bytes of the encoded '<series>' as
+ * variable length integer.
+ */
+
+#define SAMPLES_MAGIC "ZUMSMPL1"
+
+static void writesamples(Zummary *z, const char *path) {
+  char *tmp = opencache(path);
+  unsigned i, n = 0;
+  writestr(&cache, SAMPLES_MAGIC);
+  for (i = z->first; i < z->last; i++) {
+    const unsigned char *p;
+    size_t size, saved;
+    if (!sampleoffsets[i])
+      continue;
+    p = samplebytes + sampleoffsets[i];
+    size = samplesize(p, samplebytes + nsamplebytes);
+    assert(size);
+    writebytes(&cache, NAME(ENTRY(i)), strlen(NAME(ENTRY(i))) + 1);
+    saved = nsamplebytes;
+    pushvarint(size);
+    writebytes(&cache, (char *)samplebytes + saved, nsamplebytes - saved);
+    nsamplebytes = saved;
+    writebytes(&cache, (char *)samplebytes + sampleoffsets[i], size);
+    n++;
+  }
+  closecache(tmp, path);
+  msg(1, "written samples of %u entries to '%s'", n, path);
+}
+
+static void loadsamples(Zummary *z, const char *path) {
+  size_t size = file_size(path), magic = strlen(SAMPLES_MAGIC);
+  unsigned char *data, *p, *end;
+  unsigned i = z->first, n = 0;
+  FILE *file;
+  if (!(file = fopen(path, "r")))
+    die("can not read '%s'", path);
+  if (!(data = malloc(size + 1)))
+    die("out of memory allocating samples of '%s'", path);
+  if (size && fread(data, size, 1, file) != 1)
+    die("failed to read '%s'", path);
+  fclose(file);
+  if (size < magic || memcmp(data, SAMPLES_MAGIC, magic))
+    die("invalid samples file '%s'", path);
+  end = data + size;
+  for (p = data + magic; p < end; p += size) {
+    const char *name = (const char *)p;
+    unsigned long long u;
+    size_t bytes, j;
+    int cmp = 1;
+    if (!(p = memchr(p, 0, end - p)))
+      die("truncated name in '%s'", path);
+    if (!(bytes = getvarint(++p, end, &u)) || u > (size_t)(end - p - bytes) ||
+        samplesize(p + bytes, p + bytes + u) != u)
+      die("invalid samples of '%s' in '%s'", name, path);
+    p += bytes, size = u;
+    while (i < z->last && (cmp = strcmp(NAME(ENTRY(i)), name)) < 0)
+      i++;
+    if (cmp) {
+      msg(2, "ignoring samples of '%s' in '%s'", name, path);
+      continue;
+    }
+    if (!nsamplebytes)
+      pushsamplebyte(0);
+    sampleoffsets[i++] = nsamplebytes;
+    for (j = 0; j < size; j++)
+      pushsamplebyte(p[j]);
+    n++;
+  }
+  free(data);
+  msg(1, "loaded samples of %u entries from '%s'", n, path);
+}
+
+/* Samples are written after the zummary, so an older samples file belongs
+ * to an older zummary, which might have been written without '--samples'.
+ */
+static int samplesoutdated(const char *zpath, const char *spath) {
+  double ztime, stime;
+  if (!isfile(spath)) {
+    msg(1, "samples file '%s' not found", spath);
+    return 1;
+  }
+  if (!getmtime(zpath, &ztime) || !getmtime(spath, &stime))
+    return 1;
+  if (stime < ztime) {
+    msg(1, "samples file '%s' older than zummary", spath);
+    return 1;
+  }
+  return 0;
+}
+
+static void updatefingerprint(Zummary *z, const char *zpath) {
+  char *path = appendpath(z->path, "fingerprint");
+  Fingerprint f;
+  memset(&f, 0, sizeof f);
+  filesfingerprint(z, &f);
+  writefingerprint(z, zpath, path, &f);
+  clearfingerprint(&f);
+  free(path);
+}
+
+/* In streaming mode the entries of a zummary are only needed until its
+ * 'zummary' file is written and then are read back through a cursor,
+ * which also reads back their optima (see 'hasoptima').
+ */
+static void forgetentries(Zummary *z) {
+  unsigned i;
+  for (i = 0; i < nblocks; i++)
+    free(blocks[i]);
+  nblocks = nentries = 0;
+  for (i = 0; i < nsyms; i++) {
+    free(symbols[i]->name);
+    free(symbols[i]);
+  }
+  nsyms = 0;
+  if (symtab)
+    memset(symtab, 0, sizesymtab * sizeof *symtab);
+  noptima = 0;
+  z->first = z->last = 0;
+}
+
+static int islazyzummary(const char *path) {
+  size_t size = 0;
+  char *line = 0;
+  FILE *file;
+  int res = 0;
+  if (!(file = fopen(path, "r")))
+    return 0;
+  if (getline(&line, &size, file) > 0)
+    res = strstr(line, " lazy") != 0;
+  free(line);
+  fclose(file);
+  return res;
+}
+
+static int headercolumn(const char *line, const char *name) {
+  size_t len = strlen(name);
+  const char *p, *q;
+  for (p = line; (q = strstr(p, name)); p = q + len)
+    if (q > line && q[-1] == ' ' && isspace((unsigned char)q[len]))
+      return 1;
+  return 0;
+}
+
+/* Checks whether the header of the zummary has columns for all metrics.
+ */
+static int haszummarymetrics(const char *path) {
+  size_t size = 0;
+  char *line = 0;
+  unsigned j, found = 0;
+  FILE *file;
+  if (!(file = fopen(path, "r")))
+    return 0;
+  if (getline(&line, &size, file) > 0)
+    for (j = 0; j < nmetrics; j++)
+      if (headercolumn(line, metrics[j].name))
+        found++;
+  free(line);
+  fclose(file);
+  return found == nmetrics;
+}
+
+static int haszummarylines(const char *path) {
+  size_t size = 0;
+  char *line = 0;
+  FILE *file;
+  int res = 0;
+  if (!(file = fopen(path, "r")))
+    return 0;
+  if (getline(&line, &size, file) > 0)
+    res = headercolumn(line, "line");
+  free(line);
+  fclose(file);
+  return res;
+}
+
+static void zummarizeone(const char *path) {
+  char *pathtozummary, *pathtosamples;
+  int update;
+  Zummary *z;
+  assert(isdir(path));
+  z = newzummary(path);
+  msg(1, "zummarizing directory %s", path);
+  pathtozummary = appendpath(path, "zummary");
+  pathtosamples = appendpath(path, "samples");
+  update = 1;
+  if (!isfile(pathtozummary))
+    msg(1, "zummary file '%s' not found", pathtozummary);
+  else if (force)
+    msg(1, "forcing update of '%s' (through '-f' option)", pathtozummary);
+  else if (zummarystale(z, pathtozummary))
+    msg(1, "zummary '%s' needs update", pathtozummary);
+  else if ((!lazy || boundsneeded()) && islazyzummary(pathtozummary))
+    msg(1, "lazy zummary '%s' lacks bounds", pathtozummary);
+  else if (nmetrics && !haszummarymetrics(pathtozummary))
+    msg(1, "zummary '%s' lacks metrics", pathtozummary);
+  else if (samples && samplesoutdated(pathtozummary, pathtosamples))
+    msg(1, "zummary '%s' needs samples", pathtozummary);
+  else if (just && !haszummarylines(pathtozummary))
+    msg(1, "zummary '%s' lacks result line column", pathtozummary);
+  else if (stream)
+    update = 0;
+  else {
+    loadzummary(z, pathtozummary);
+    if (samples)
+      loadsamples(z, pathtosamples);
+    update = 0;
+  }
+  if (update && stream && nowrite)
+    die("can not stream '%s' without writing its zummary", path);
+  if (update) {
+    updatezummary(z);
+    fixzummary(z, LOCAL_ZUMMARY);
+    if (filtered)
+      msg(1, "not writing zummary of filtered instances in '%s'", path);
+    else if (!nowrite && z->cnt) {
+      writezummary(z, pathtozummary);
+      if (samples)
+        writesamples(z, pathtosamples);
+      if (fastcheck)
+        updatefingerprint(z, pathtozummary);
+    }
+    if (stream)
+      forgetentries(z);
+  }
+  if (update && !stream && (just || nobounds)) {
+    unsigned i;
+    for (i = z->first; i < z->last; i++)
+      applyparseoptions(ENTRY(i));
+  }
+  free(pathtosamples);
+  free(pathtozummary);
+}
+
+/*------------------------------------------------------------------------*/
+
+/* With '--recursive <root>' walker threads expand the directories of the
+ * tree below '<root>' in parallel, i.e., read them, sort their entries
+ * and determine whether they are run directories with a 'zummary' file or
+ * an '.err' file with matching '.log' file.  Meanwhile the main thread
+ * visits the expanded directories in sorted depth-first order and
+ * zummarizes run directories as soon as they are reached, expanding
+ * directories itself if no walker got to them yet.  Thus discovery
+ * overlaps with parsing, while directories are still added in the same
+ * order as if they were given sorted on the command line.  Hidden
+ * directories and symbolic links are not followed.  Walkers must not call
+ * 'die', thus running out of memory while expanding is only recorded and
+ * reported after all walkers are joined.
+ */
+
+#ifndef WALKERS
+#define WALKERS 8
+#endif
+
+#define WALK_NEW 0
+#define WALK_BUSY 1
+#define WALK_DONE 2
+
+static struct {
+  Walk **queue;
+  unsigned nqueue, sizequeue, busy;
+  int nomemory;
+#ifndef NTHREADS
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+#endif
+} walker;
+
+#ifndef NTHREADS
+#define LOCKWALK() pthread_mutex_lock(&walker.lock)
+#define UNLOCKWALK() pthread_mutex_unlock(&walker.lock)
+#define WAITWALK() pthread_cond_wait(&walker.cond, &walker.lock)
+#define SIGNALWALK() pthread_cond_broadcast(&walker.cond)
+#else
+#define LOCKWALK() (void)0
+#define UNLOCKWALK() (void)0
+#define WAITWALK() assert(!"waiting without walker threads")
+#define SIGNALWALK() (void)0
+#endif
+
+static Walk *newwalk(char *path) {
+  Walk *w;
+  if (!path || !(w = calloc(1, sizeof *w))) {
+    free(path);
+    return 0;
+  }
+  w->path = path;
+  return w;
+}
+
+static int cmpstr4qsort(const void *p, const void *q) {
+  return strcmp(*(char *const *)p, *(char *const *)q);
+}
+
+/* Same as 'appendpath' but returns zero if out of memory.
+ */
+static char *walkpath(const char *prefix, const char *name) {
+  size_t len = strlen(prefix);
+  char *res;
+  while (len > 0 && prefix[len - 1] == '/')
+    len--;
+  if (!(res = malloc(len + strlen(name) + 2)))
+    return 0;
+  memcpy(res, prefix, len);
+  res[len] = '/';
+  strcpy(res + len + 1, name);
+  return res;
+}
+
+/* Returns a negative value if out of memory.
+ */
+static int issubdir(const char *path, struct dirent *dirent) {
+#ifdef DT_DIR
+  if (dirent->d_type == DT_DIR)
+    return 1;
+  if (dirent->d_type != DT_UNKNOWN)
+    return 0;
+#endif
+  struct stat buf;
+  char *subpath = walkpath(path, dirent->d_name);
+  int res;
+  if (!subpath)
+    return -1;
+  res = !lstat(subpath, &buf) && S_ISDIR(buf.st_mode);
+  free(subpath);
+  return res;
+}
+
+/* Reads the directory without holding the lock, since this is what takes
+ * time, and then publishes the result and queues the children.  If out of
+ * memory the directory is published without children.
+ */
+static void expandwalk(Walk *w) {
+  unsigned n = 0, size = 0, ndirs = 0, i, j;
+  char **names = 0, **newnames;
+  Walk **children = 0, **newqueue;
+  struct dirent *dirent;
+  int run = 0, failed = 0, nomemory = 0;
+  size_t len;
+  DIR *dir;
+  if (!(dir = opendir(w->path)))
+    failed = 1;
+  else {
+    while ((dirent = readdir(dir))) {
+      const char *name = dirent->d_name;
+      int subdir;
+      if (!strcmp(name, "zummary"))
+        run = 1;
+      subdir = name[0] != '.' && issubdir(w->path, dirent);
+      if (subdir < 0) {
+        nomemory = 1;
+        break;
+      }
+      if (!subdir && !strstr(name, ".err") && !strstr(name, ".log"))
+        continue;
+      if (n == size) {
+        size = size ? 2 * size : 64;
+        if (!(newnames = realloc(names, size * sizeof *names))) {
+          nomemory = 1;
+          break;
+        }
+        names = newnames;
+      }
+      if (!(names[n] = malloc(strlen(name) + 2))) {
+        nomemory = 1;
+        break;
+      }
+      names[n][0] = subdir ? 'd' : 'f'; // directories sort first
+      strcpy(names[n] + 1, name);
+      n++;
+    }
+    (void)closedir(dir);
+  }
+  if (n)
+    qsort(names, n, sizeof *names, cmpstr4qsort);
+  for (i = j = 0; i < n; i++)
+    if (names[i][0] == 'd')
+      names[j++] = names[i];
+    else {
+      len = strlen(names[i]);
+      if (!run && len >= 4 && !strcmp(names[i] + len - 4, ".err")) {
+        strcpy(names[i] + len - 4, ".log");
+        run = bsearch(names + i, names + i + 1, n - i - 1, sizeof *names,
+                      cmpstr4qsort) != 0;
+      }
+      free(names[i]);
+    }
+  ndirs = j;
+  if (!nomemory && ndirs && !(children = malloc(ndirs * sizeof *children)))
+    nomemory = 1;
+  for (i = j = 0; i < ndirs; i++) {
+    if (!nomemory && (children[j] = newwalk(walkpath(w->path, names[i] + 1))))
+      j++;
+    else
+      nomemory = 1;
+    free(names[i]);
+  }
+  free(names);
+  ndirs = j;
+  LOCKWALK();
+  if (!nomemory && walker.nqueue + ndirs > walker.sizequeue) {
+    unsigned newsize = walker.sizequeue ? 2 * walker.sizequeue : 64;
+    while (newsize < walker.nqueue + ndirs)
+      newsize *= 2;
+    newqueue = realloc(walker.queue, newsize * sizeof *walker.queue);
+    if (!newqueue)
+      nomemory = 1;
+    else
+      walker.queue = newqueue, walker.sizequeue = newsize;
+  }
+  if (nomemory) {
+    for (i = 0; i < ndirs; i++)
+      free(children[i]->path), free(children[i]);
+    free(children);
+    children = 0, ndirs = 0;
+    walker.nomemory = 1;
+  }
+  w->children = children;
+  w->nchildren = ndirs;
+  w->run = run;
+  w->failed = failed;
+  w->state = WALK_DONE;
+  for (i = ndirs; i--;)
+    walker.queue[walker.nqueue++] = children[i];
+  walker.busy--;
+  SIGNALWALK();
+  UNLOCKWALK();
+}
+
+#ifndef NTHREADS
+
+/* Walkers stop if the queue is empty and no directory is being expanded,
+ * since only expanding adds to the queue.
+ */
+static void *walkthread(void *p) {
+  Walk *w;
+  (void)p;
+  LOCKWALK();
+  for (;;) {
+    while (!walker.nqueue && walker.busy)
+      WAITWALK();
+    if (!walker.nqueue)
+      break;
+    w = walker.queue[--walker.nqueue];
+    if (w->state != WALK_NEW)
+      continue;
+    w->state = WALK_BUSY;
+    walker.busy++;
+    UNLOCKWALK();
+    expandwalk(w);
+    LOCKWALK();
+  }
+  UNLOCKWALK();
+  return 0;
+}
+
+#endif
+
+static void visitwalk(Walk *w) {
+  int nomemory;
+  unsigned i;
+  LOCKWALK();
+  while (w->state != WALK_DONE)
+    if (w->state == WALK_NEW) {
+      w->state = WALK_BUSY;
+      walker.busy++;
+      UNLOCKWALK();
+      expandwalk(w);
+      LOCKWALK();
+    } else
+      WAITWALK();
+  nomemory = walker.nomemory;
+  UNLOCKWALK();
+  if (nomemory)
+    return;
+  if (w->failed)
+    wrn("can not read directory '%s'", w->path);
+  else if (w->run) {
+    msg(1, "found run directory '%s'", w->path);
+    zummarizeone(w->path);
+  }
+  for (i = 0; i < w->nchildren; i++)
+    visitwalk(w->children[i]);
+}
+
+static void deletewalk(Walk *w) {
+  unsigned i;
+  for (i = 0; i < w->nchildren; i++)
+    deletewalk(w->children[i]);
+  free(w->children);
+  free(w->path);
+  free(w);
+}
+
+static void walkrecursive(const char *root) {
+  Walk *w = newwalk(strdup(root));
+  unsigned found = nzummaries;
+#ifndef NTHREADS
+  pthread_t threads[WALKERS];
+  unsigned i;
+#endif
+  if (!w)
+    die("out of memory allocating directory walk");
+  walker.nqueue = walker.busy = 0;
+  walker.nomemory = 0;
+  walker.queue = malloc(sizeof *walker.queue);
+  if (!walker.queue)
+    die("out of memory allocating directory queue");
+  walker.sizequeue = 1;
+  walker.queue[walker.nqueue++] = w;
+#ifndef NTHREADS
+  pthread_mutex_init(&walker.lock, 0);
+  pthread_cond_init(&walker.cond, 0);
+  for (i = 0; i < WALKERS; i++)
+    if (pthread_create(threads + i, 0, walkthread, 0))
+      die("failed to start thread walking '%s'", root);
+#endif
+  visitwalk(w);
+#ifndef NTHREADS
+  for (i = 0; i < WALKERS; i++)
+    pthread_join(threads[i], 0);
+  pthread_mutex_destroy(&walker.lock);
+  pthread_cond_destroy(&walker.cond);
+#endif
+  deletewalk(w);
+  free(walker.queue);
+  walker.queue = 0, walker.sizequeue = 0;
+  if (walker.nomemory)
+    die("out of memory walking directories below '%s'", root);
+  msg(1, "found %u run directories below '%s'", nzummaries - found, root);
+}
+
+/*------------------------------------------------------------------------*/
+
+/* A partial is a binary file with all the entries of the zummaries of one
+ * node and the number of SAT and UNSAT votes per instance.  Partials of
+ * several nodes are combined as if all directories had been zummarized
+ * locally, where directories with the same path on different nodes are
+ * considered to be shards of the same run.  All numbers are written in
+ * little endian order to be independent of the node architecture.
+ *
+ *   "ZUMPART1"
+ *   <symbols> ( <name> 0 <sat> <uns> )*
+ *   <zummaries> ( <path> 0 <tlim> <rlim> <slim> <ubndbroken> <count>
+ *                 ( <symbol> <tim> <wll> <mem> <bnd> <res> <flags>
+ *                   [ <obnd> ] )* )*
+ *
+ * Counts, votes, symbols indices and resources are 32 bit, limits are
+ * 64 bit doubles, 'ubndbroken', 'res' and 'flags' are single bytes and
+ * the optimum 'obnd' is 64 bit, but only present if 'PARTIAL_OPT' is set.
+ */
+
+#define PARTIAL_MAGIC "ZUMPART1"
+
+#define PARTIAL_TIO 1
+#define PARTIAL_MEO 2
+#define PARTIAL_UNK 4
+#define PARTIAL_S11 8
+#define PARTIAL_SI6 16
+#define PARTIAL_OPT 32
+
+static void putu32(FILE *file, unsigned u) {
+  int i;
+  for (i = 0; i < 4; i++)
+    fputc((u >> (8 * i)) & 255, file);
+}
+
+static void putu64(FILE *file, unsigned long long u) {
+  int i;
+  for (i = 0; i < 8; i++)
+    fputc((u >> (8 * i)) & 255, file);
+}
+
+static void putdouble(FILE *file, double d) {
+  unsigned long long u;
+  memcpy(&u, &d, sizeof u);
+  putu64(file, u);
+}
+
+static void putstr(FILE *file, const char *str) {
+  fputs(str, file);
+  fputc(0, file);
+}
+
+static void writepartial(const char *path) {
+  unsigned i, j, *votes;
+  FILE *file;
+  Entry *e;
+  int k;
+  votes = calloc(2 * (size_t)nsyms + 1, sizeof *votes);
+  if (!votes)
+    die("out of memory allocating votes");
+  for (i = 1; i < nentries; i++) {
+    e = ENTRY(i);
+    if (e->res == 10)
+      votes[2 * e->symbol]++;
+    if (e->res == 20)
+      votes[2 * e->symbol + 1]++;
+  }
+  if (!(file = fopen(path, "wb")))
+    die("can not write partial '%s'", path);
+  fputs(PARTIAL_MAGIC, file);
+  putu32(file, nsyms);
+  for (i = 0; i < nsyms; i++) {
+    putstr(file, symbols[i]->name);
+    putu32(file, votes[2 * i]);
+    putu32(file, votes[2 * i + 1]);
+  }
+  free(votes);
+  if (noptima)
+    qsort(optima, noptima, sizeof *optima, cmpoptima4qsort);
+  putu32(file, nzummaries);
+  for (k = 0; k < nzummaries; k++) {
+    Zummary *z = directories[k];
+    putstr(file, z->path);
+    putdouble(file, z->tlim);
+    putdouble(file, z->rlim);
+    putdouble(file, z->slim);
+    fputc(z->ubndbroken, file);
+    putu32(file, z->last - z->first);
+    for (j = z->first; j < z->last; j++) {
+      unsigned flags = 0;
+      e = ENTRY(j);
+      putu32(file, e->symbol);
+      putu32(file, e->tim);
+      putu32(file, e->wll);
+      putu32(file, e->mem);
+      putu32(file, e->bnd);
+      fputc(e->res, file);
+      if (e->tio)
+        flags |= PARTIAL_TIO;
+      if (e->meo)
+        flags |= PARTIAL_MEO;
+      if (e->unk)
+        flags |= PARTIAL_UNK;
+      if (e->s11)
+        flags |= PARTIAL_S11;
+      if (e->si6)
+        flags |= PARTIAL_SI6;
+      if (e->opt)
+        flags |= PARTIAL_OPT;
+      fputc(flags, file);
+      if (e->opt)
+        putu64(file, getoptimum(e));
+    }
+  }
+  if (fclose(file))
+    die("failed to write partial '%s'", path);
+  msg(1, "written %d zummaries with %u entries to partial '%s'", nzummaries,
+      nentries ? nentries - 1 : 0, path);
+}
+
+typedef struct Reader {
+  const char *path;
+  unsigned char *p, *end;
+} Reader;
+
+static void needbytes(Reader *r, size_t bytes) {
+  if ((size_t)(r->end - r->p) < bytes)
+    die("truncated partial '%s'", r->path);
+}
+
+static unsigned getbyte(Reader *r) {
+  needbytes(r, 1);
+  return *r->p++;
+}
+
+static unsigned getu32(Reader *r) {
+  unsigned res = 0;
+  int i;
+  needbytes(r, 4);
+  for (i = 0; i < 4; i++)
+    res |= (unsigned)*r->p++ << (8 * i);
+  return res;
+}
+
+static unsigned long long getu64(Reader *r) {
+  unsigned long long res = 0;
+  int i;
+  needbytes(r, 8);
+  for (i = 0; i < 8; i++)
+    res |= (unsigned long long)*r->p++ << (8 * i);
+  return res;
+}
+
+static double getdouble(Reader *r) {
+  unsigned long long u = getu64(r);
+  double res;
+  memcpy(&res, &u, sizeof res);
+  return res;
+}
+
+static const char *getstr(Reader *r) {
+  unsigned char *q = memchr(r->p, 0, r->end - r->p);
+  const char *res = (const char *)r->p;
+  if (!q)
+    die("truncated partial '%s'", r->path);
+  r->p = q + 1;
+  return res;
+}
+
+static void newshard(Reader *r, Partial *p) {
+  Shard *s;
+  if (nshards == sizeshards) {
+    unsigned newsizeshards = sizeshards ? 2 * sizeshards : 1;
+    shards = realloc(shards, newsizeshards * sizeof *shards);
+    if (!shards)
+      die("out of memory reallocating shards");
+    sizeshards = newsizeshards;
+  }
+  s = shards + nshards;
+  s->seq = nshards++;
+  s->partial = p - partials;
+  s->path = getstr(r);
+  s->tlim = getdouble(r);
+  s->rlim = getdouble(r);
+  s->slim = getdouble(r);
+  s->ubndbroken = getbyte(r);
+  s->count = getu32(r);
+  s->offset = r->p - p->data;
+}
+
+/* Reads the whole partial and checks that the votes match the entries.
+ * The entries themselves are only added later in 'combinepartial'.
+ */
+static void readpartial(const char *path) {
+  unsigned i, j, n, *votes, *counted;
+  size_t bytes = file_size(path);
+  Partial *p;
+  Reader r;
+  FILE *file;
+  if (npartials == sizepartials) {
+    int newsizepartials = sizepartials ? 2 * sizepartials : 1;
+    partials = realloc(partials, newsizepartials * sizeof *partials);
+    if (!partials)
+      die("out of memory reallocating partials");
+    sizepartials = newsizepartials;
   }
-  for (e = z->first; e; e = e->next) {
-    if (e->res < 10)
-      continue;
-    assert(e->res == 10 || e->res == 20);
-    if (!e->tio && e->tim > z->tlim) {
-      msg(1, "error file '%s/%s.err' actually exceeds time limit", z->path,
-          e->name);
-      e->tio = 1;
-    } else if (!e->tio && e->wll > z->rlim) {
-      msg(1, "error file '%s/%s.err' actually exceeds real time limit", z->path,
-          e->name);
-      e->tio = 1;
-    } else if (!e->meo && e->mem > z->slim) {
-      msg(1, "error file '%s/%s.err' actually exceeds space limit", z->path,
-          e->name);
-      e->meo = 1;
-    }
+  p = partials + npartials++;
+  memset(p, 0, sizeof *p);
+  if (!(p->path = strdup(path)))
+    die("out of memory copying partial path");
+  if (!(file = fopen(path, "rb")))
+    die("can not read partial '%s'", path);
+  if (!(p->data = malloc(bytes ? bytes : 1)))
+    die("out of memory allocating partial '%s'", path);
+  if (fread(p->data, 1, bytes, file) != bytes)
+    die("failed to read partial '%s'", path);
+  fclose(file);
+  p->size = bytes;
+  r.path = path;
+  r.p = p->data;
+  r.end = p->data + bytes;
+  needbytes(&r, strlen(PARTIAL_MAGIC));
+  if (memcmp(r.p, PARTIAL_MAGIC, strlen(PARTIAL_MAGIC)))
+    die("invalid partial '%s'", path);
+  r.p += strlen(PARTIAL_MAGIC);
+  p->nnames = getu32(&r);
+  if (p->nnames > bytes)
+    die("invalid number of instances in partial '%s'", path);
+  p->names = malloc((p->nnames + 1) * sizeof *p->names);
+  votes = malloc((4 * (size_t)p->nnames + 1) * sizeof *votes);
+  if (!p->names || !votes)
+    die("out of memory allocating partial instances");
+  counted = votes + 2 * p->nnames;
+  for (i = 0; i < p->nnames; i++) {
+    p->names[i] = getstr(&r);
+    votes[2 * i] = getu32(&r);
+    votes[2 * i + 1] = getu32(&r);
+    counted[2 * i] = counted[2 * i + 1] = 0;
   }
-  for (e = z->first; e; e = e->next) {
-    if (zummary_mode == GLOBAL_ZUMMARY_HAVE_BEST) {
-      if (satonly && (!e->best || e->best->res != 10))
-        continue;
-      if (unsatonly && (!e->best || e->best->res != 20))
-        continue;
-      if (deeponly) {
-        if (e->best) {
-          if (e->best->res == 10)
-            continue;
-          if (e->best->res == 20)
-            continue;
-        }
-      }
-      if (e->best == e || (e->best && !cmp_entry_better(e, e->best))) {
-        assert(!e->dis);
-        z->bst++;
-        assert((e->symbol->sat > 0) + (e->symbol->uns > 0) < 2);
-        if ((e->res == 10 && e->symbol->sat == 1) ||
-            (e->res == 20 && e->symbol->uns == 1)) {
-          msg(2, "unique (SOTA) '%s/%s'", e->zummary->path, e->name);
-          z->unq++;
-        }
-      }
-    }
-    z->cnt++;
-    assert(!e->tio + !e->meo + !e->unk >= 2);
-    if (e->dis)
-      assert(zummary_mode != LOCAL_ZUMMARY), e->res = 4, z->dis++;
-    else if (e->s11)
-      e->res = 5, z->s11++;
-    else if (e->si6)
-      e->res = 6, z->si6++;
-    else if (e->tio)
-      e->res = 1, z->tio++;
-    else if (e->meo)
-      e->res = 2, z->meo++;
-    else if (e->res == 10)
-      z->sat++;
-    else if (e->res == 20)
-      z->uns++;
-    else
-      e->unk = 1, e->res = 3, z->unk++;
-    assert(e->res);
-    if (e->res == 10 || e->res == 20) {
-      z->tim += e->tim, z->wll += e->wll, z->mem += e->mem;
-      if (e->mem > z->max)
-        z->max = e->mem;
+  n = getu32(&r);
+  for (i = 0; i < n; i++) {
+    newshard(&r, p);
+    for (j = shards[nshards - 1].count; j; j--) {
+      unsigned symbol = getu32(&r), res, flags;
+      if (symbol >= p->nnames)
+        die("invalid instance index in partial '%s'", path);
+      needbytes(&r, 16);
+      r.p += 16;
+      res = getbyte(&r);
+      flags = getbyte(&r);
+      if (flags & PARTIAL_OPT)
+        (void)getu64(&r);
+      if (res == 10)
+        counted[2 * symbol]++;
+      if (res == 20)
+        counted[2 * symbol + 1]++;
     }
-    if (z->ubndbroken && e->bnd >= 0 && e->res != 10) {
-      if (z->ubndbroken == UBND_GLOBALLY_BROKEN)
-        assert(zummary_mode != LOCAL_ZUMMARY);
-      e->bnd = -1;
-    }
-    if (e->bnd >= 0 && e->res != 4)
-      z->bnd++;
-  }
-  z->sol = z->sat + z->uns;
-  z->fld = z->tio + z->meo + z->s11 + z->si6 + z->unk;
-  assert(z->cnt == z->sol + z->fld + z->dis);
-  if (par) {
-    if (usereal)
-      z->par = z->wll + par * z->rlim * z->fld;
-    else
-      z->par = z->tim + par * z->tlim * z->fld;
   }
-  if (zummary_mode != LOCAL_ZUMMARY)
-    z->only_use_for_reporting_and_do_not_write = 1;
+  if (r.p != r.end)
+    die("trailing garbage in partial '%s'", path);
+  for (i = 0; i < 2 * p->nnames; i++)
+    if (votes[i] != counted[i])
+      die("%s votes of '%s' do not match in partial '%s'",
+          (i & 1) ? "UNSAT" : "SAT", p->names[i / 2], path);
+  free(votes);
+  msg(1, "read partial '%s' with %u zummaries and %u instances", path, n,
+      p->nnames);
 }
 
-static int mystrcmp(const char *a, const char *b) { return strcmp(a, b); }
+static int cmpshards4qsort(const void *p, const void *q) {
+  const Shard *a = p, *b = q;
+  int res = strcmp(a->path, b->path);
+  if (res)
+    return res;
+  return a->seq < b->seq ? -1 : 1;
+}
 
-static void loadzummary(Zummary *z, const char *path) {
-  int first = 1;
-  assert(!z->cnt);
-  msg(1, "trying to load zummary '%s'", path);
-  open_input(path);
-  lineno = 1;
-  while (parsezummaryline()) {
-    if (!first) {
-      double tlim, rlim, slim;
-      Entry *e;
-      if (ntokens < 8 || ntokens > 9)
-        die("invalid line in '%s'", path);
-      e = newentry(z, tokens[0]);
-      e->res = atoi(tokens[1]);
-      e->tim = atof(tokens[2]);
-      e->wll = atof(tokens[3]);
-      e->mem = atof(tokens[4]);
-      tlim = atof(tokens[5]);
-      if (tlim <= 0)
-        die("invalid time limit %.0f in '%s'", tlim, path);
-      if (z->tlim < 0) {
-        msg(1, "setting time limit of '%s' to %.0f", z->path, tlim);
-        z->tlim = tlim;
-      } else if (!ignore && z->tlim != tlim)
-        wrn("different time limit %.0f in '%s'", tlim, path);
-      rlim = atof(tokens[6]);
-      if (rlim <= 0)
-        die("invalid real time limit %.0f in '%s'", rlim, path);
-      if (z->rlim < 0) {
-        msg(1, "setting real time limit of '%s' to %.0f", z->path, rlim);
-        z->rlim = rlim;
-      } else if (!ignore && z->rlim != rlim)
-        wrn("different real time limit %.0f in '%s'", rlim, path);
-      slim = atof(tokens[7]);
-      if (slim <= 0)
-        die("invalid space limit %.0f in '%s'", slim, path);
-      if (z->slim < 0) {
-        msg(1, "setting space limit of '%s' to %.0f", z->path, slim);
-        z->slim = slim;
-      } else if (!ignore && z->slim != slim)
-        wrn("different space limit %.0f in '%s'", slim, path);
-      if (ntokens < 9 || (e->bnd = atof(tokens[8])) < 0)
-        e->bnd = -1;
-      if (ntokens == 9)
-        msg(2, "loaded %s %d %.2f %.2f %.1f %.2f %.2f %.1f %d", e->name, e->res,
-            e->tim, e->wll, e->mem, tlim, rlim, slim, e->bnd);
-      else
-        msg(2, "loaded %s %d %.2f %.2f %.1f %.2f %.2f %.1f", e->name, e->res,
-            e->tim, e->wll, e->mem, tlim, rlim, slim);
-
-      if (e->res != 10 && e->res != 20) {
-        assert(e->res != 4);
-        if (e->res == 1)
-          e->tio = 1;
-        if (e->res == 2)
-          e->meo = 1;
-        else if (e->res == 3)
-          e->unk = 1;
-        else if (e->res == 4)
-          e->dis = 1; // TODO remove?
-        else if (e->res == 5)
-          e->s11 = 1;
-        else if (e->res == 6)
-          e->si6 = 1;
-      }
+static int cmpseq4qsort(const void *p, const void *q) {
+  const Shard *a = *(Shard **)p, *b = *(Shard **)q;
+  return a->seq < b->seq ? -1 : a->seq > b->seq;
+}
 
-    } else if (ntokens < 7 || ntokens > 8 || mystrcmp(tokens[0], "result") ||
-               mystrcmp(tokens[1], "time") || mystrcmp(tokens[2], "real") ||
-               mystrcmp(tokens[3], "space") || mystrcmp(tokens[4], "tlim") ||
-               mystrcmp(tokens[5], "rlim") || mystrcmp(tokens[6], "slim") ||
-               (ntokens == 8 && mystrcmp(tokens[7], "bound")))
-      die("invalid header in '%s'", path);
-    else
-      first = 0;
+static void addshard(Zummary *z, Shard *s) {
+  Partial *p = partials + s->partial;
+  unsigned i;
+  Reader r;
+  r.path = p->path;
+  r.p = p->data + s->offset;
+  r.end = p->data + p->size;
+  if (z->tlim < 0) {
+    z->tlim = s->tlim, z->rlim = s->rlim, z->slim = s->slim;
+  } else if (!ignore) {
+    if (z->tlim != s->tlim)
+      wrn("different time limit %.0f in '%s' of '%s'", s->tlim, s->path,
+          p->path);
+    if (z->rlim != s->rlim)
+      wrn("different real time limit %.0f in '%s' of '%s'", s->rlim, s->path,
+          p->path);
+    if (z->slim != s->slim)
+      wrn("different space limit %.0f in '%s' of '%s'", s->slim, s->path,
+          p->path);
+  }
+  if (s->ubndbroken > z->ubndbroken)
+    z->ubndbroken = s->ubndbroken;
+  for (i = 0; i < s->count; i++) {
+    const char *name = p->names[getu32(&r)];
+    Entry *e = newentry(z, name, strlen(name));
+    unsigned flags;
+    e->tim = getu32(&r);
+    e->wll = getu32(&r);
+    e->mem = getu32(&r);
+    e->bnd = (int)getu32(&r);
+    e->res = getbyte(&r);
+    flags = getbyte(&r);
+    e->tio = !!(flags & PARTIAL_TIO);
+    e->meo = !!(flags & PARTIAL_MEO);
+    e->unk = !!(flags & PARTIAL_UNK);
+    e->s11 = !!(flags & PARTIAL_S11);
+    e->si6 = !!(flags & PARTIAL_SI6);
+    if (flags & PARTIAL_OPT)
+      newoptimum(e, (long)getu64(&r));
   }
-  msg(1, "loaded %d entries from '%s'", z->cnt, path);
-  close_input(path);
-  sortzummary(z);
-  loaded++;
 }
 
-static void updatezummary(Zummary *z) {
-  struct dirent *dirent;
-  DIR *dir;
-  Entry *e;
-  msg(1, "updating zummary for directory '%s'", z->path);
-  if (!(dir = opendir(z->path)))
-    die("can not open directory '%s' for updating", z->path);
-  z->cnt = 0;
-  while ((dirent = readdir(dir))) {
-    char *base, *logname, *logpath;
-    const char *errname = dirent->d_name;
-    msg(2, "checking '%s'", errname);
-    if (!(base = stripsuffix(errname, ".err"))) {
-      msg(2, "skipping '%s'", errname);
-      continue;
-    }
-    logname = appendstr(base, ".log");
-    logpath = appendpath(z->path, logname);
-    if (isfile(logpath)) {
-      char *errpath = appendpath(z->path, errname);
-      e = newentry(z, base);
-      assert(isfile(errpath));
-      if (parserrfile(e, errpath))
-        parselogfile(e, logpath);
-      free(errpath);
-      assert(!e->res || e->res == 10 || e->res == 20);
-      if (e->tio && e->res)
-        wrn("result %d with time-out in '%s/%s'", e->res, z->path, base);
-      if (e->meo && e->res)
-        wrn("result %d with memory-out in '%s/%s'", e->res, z->path, base);
-      if (e->s11 && e->res)
-        wrn("result %d with 'segmentation fault' in '%s/%s'", e->res, z->path,
-            base);
-      if (e->s11 && e->res)
-        wrn("result %d with 'segmentation fault' (s11) in '%s/%s'", e->res,
-            z->path, base);
-      if (e->si6 && e->res)
-        wrn("result %d with 'abort signal' (s6) in '%s/%s'", e->res, z->path,
-            base);
-      if (e->unk && e->res)
-        wrn("result %d and unknown status in '%s/%s'", e->res, z->path, base);
-    } else
-      msg(1, "missing '%s'", logpath);
-    free(logpath);
-    free(logname);
-    free(base);
-  }
-  (void)closedir(dir);
-  msg(1, "found %d entries in '%s'", z->cnt, z->path);
-  if (z->cnt) {
-    if (z->tlim < 0)
-      die("no time limit in '%s'", z->path);
-    if (z->rlim < 0)
-      die("no real time limit in '%s'", z->path);
-    if (z->slim < 0)
-      die("no space limit in '%s'", z->path);
-    if (nzummaries > 1 && z->cnt) {
-      if (!ignore && z->tlim != zummaries[0]->tlim)
-        wrn("different time limit '%.0f' in '%s'", z->tlim, z->path);
-      if (!ignore && z->rlim != zummaries[0]->rlim)
-        wrn("different real time limit '%.0f' in '%s'", z->rlim, z->path);
-      if (!ignore && z->slim != zummaries[0]->slim)
-        wrn("different space limit '%.0f' in '%s'", z->slim, z->path);
-    }
+/* Shards with the same path become one zummary, which is created when the
+ * partial in which the path first occurs is reached on the command line,
+ * such that zummaries are in the same order as if all directories were
+ * local.  Thus all partials are read before any zummary is created and
+ * since the entries of a zummary have to be allocated together all shards
+ * of a path are added in one go.
+ */
+static void groupshards() {
+  unsigned i, j;
+  qsort(shards, nshards, sizeof *shards, cmpshards4qsort);
+  groups = malloc((nshards + 1) * sizeof *groups);
+  if (!groups)
+    die("out of memory allocating shard groups");
+  for (i = 0; i < nshards; i = j) {
+    for (j = i + 1; j < nshards && !strcmp(shards[i].path, shards[j].path);
+         j++)
+      ;
+    groups[ngroups++] = shards + i;
   }
-  sortzummary(z);
-  updated++;
+  qsort(groups, ngroups, sizeof *groups, cmpseq4qsort);
 }
 
-static void writezummary(Zummary *z, const char *path) {
-  int printbounds;
-  FILE *file;
-  Entry *e;
-  assert(!z->only_use_for_reporting_and_do_not_write);
-  file = fopen(path, "w");
-  if (!file)
-    die("can not write '%s'", path);
-  fputs(" result time real space tlim rlim slim", file);
-  if ((printbounds = !nobounds && z->bnd > 0))
-    fputs(" bound", file);
-  fputc('\n', file);
-  for (e = z->first; e; e = e->next) {
-    fprintf(file, "%s %d %.2f %.2f %.1f %.0f %.0f %.0f", e->name, e->res,
-            e->tim, e->wll, e->mem, z->tlim, z->rlim, z->slim);
-    if (printbounds)
-      fprintf(file, " %d", e->bnd);
-    fputc('\n', file);
+static void combinepartial(unsigned partial) {
+  unsigned i, k;
+  for (i = 0; i < ngroups; i++) {
+    Shard *s = groups[i];
+    Zummary *z;
+    if (s->partial != partial)
+      continue;
+    z = newzummary(s->path);
+    for (; s < shards + nshards && !strcmp(s->path, z->path); s++)
+      addshard(z, s);
+    sortzummary(z);
+    for (k = z->first + 1; k < z->last; k++)
+      if (ENTRY(k - 1)->symbol == ENTRY(k)->symbol)
+        die("instance '%s' of '%s' occurs in several partials",
+            NAME(ENTRY(k)), z->path);
+    msg(1, "combined %d entries of '%s'", z->cnt, z->path);
+    loaded++;
   }
-  fclose(file);
-  msg(1, "written %d entries to zummary '%s'", z->cnt, path);
-  written++;
 }
 
-static void zummarizeone(const char *path) {
-  char *pathtozummary;
-  int update;
-  Zummary *z;
-  assert(isdir(path));
-  z = newzummary(path);
-  msg(1, "zummarizing directory %s", path);
-  pathtozummary = appendpath(path, "zummary");
-  update = 1;
-  if (!isfile(pathtozummary))
-    msg(1, "zummary file '%s' not found", pathtozummary);
-  else if (force)
-    msg(1, "forcing update of '%s' (through '-f' option)", pathtozummary);
-  else if (zummaryneedsupdate(z, pathtozummary))
-    msg(1, "zummary '%s' needs update", pathtozummary);
-  else {
-    loadzummary(z, pathtozummary);
-    update = 0;
+static void releasepartials() {
+  unsigned i;
+  int l, count;
+  for (i = 0; i < ngroups; i++) {
+    for (count = l = 0; l < nzummaries; l++)
+      count += !strcmp(zummaries[l]->path, groups[i]->path);
+    if (count > 1)
+      die("directory '%s' occurs locally and in partial '%s'",
+          groups[i]->path, partials[groups[i]->partial].path);
   }
-  if (update) {
-    updatezummary(z);
-    if (!nowrite && z->cnt) {
-      fixzummary(z, LOCAL_ZUMMARY);
-      writezummary(z, pathtozummary);
-    }
+  free(groups);
+  groups = 0, ngroups = 0;
+  for (l = 0; l < npartials; l++) {
+    free(partials[l].path);
+    free(partials[l].data);
+    free(partials[l].names);
   }
-  free(pathtozummary);
+  free(partials);
+  free(shards);
+  partials = 0, shards = 0;
+  npartials = sizepartials = 0;
+  nshards = sizeshards = 0;
 }
 
 static int cmpsyms4qsort(const void *p, const void *q) {
@@ -1922,104 +4697,113 @@ static void sortsymbols() {
   msg(2, "sorted %d symbols", nsyms);
 }
 
-static void discrepancies() {
-  int i, count = 0;
-  for (i = 0; i < nsyms; i++) {
-    int sat = 0, unsat = 0, expected;
-    Symbol *s = symtab[i];
-    Entry *e;
-    char cmp;
-    for (e = s->first; e; e = e->chain) {
-      assert(e->name == s->name);
-      if (e->res == 10)
-        sat++;
-      if (e->res == 20)
-        unsat++;
-    }
-    if (!sat)
-      continue;
-    if (!unsat)
+static int resultdiscrepancy(Symbol *s) {
+  int sat = 0, unsat = 0, expected;
+  Entry *e;
+  char cmp;
+  for (e = entry(s->first); e; e = entry(e->chain)) {
+    assert(NAME(e) == s->name);
+    if (e->res == 10)
+      sat++;
+    if (e->res == 20)
+      unsat++;
+  }
+  if (!sat)
+    return 0;
+  if (!unsat)
+    return 0;
+  if (sat > unsat)
+    expected = 10, cmp = '>';
+  else if (sat < unsat)
+    expected = 20, cmp = '<';
+  else
+    expected = 0, cmp = '=';
+  wrn("DISCREPANCY on '%s' with %d SAT %c %d UNSAT", s->name, sat, cmp, unsat);
+  for (e = entry(s->first); e; e = entry(e->chain)) {
+    const char *suffix;
+    if (e->res < 10)
       continue;
-    if (sat > unsat)
-      expected = 10, cmp = '>';
-    else if (sat < unsat)
-      expected = 20, cmp = '<';
+    assert(e->res == 10 || e->res == 20);
+    if (!expected)
+      suffix = " (tie so assumed wrong)";
+    else if (e->res != expected)
+      suffix = " (overvoted so probably wrong)";
     else
-      expected = 0, cmp = '=';
-    wrn("DISCREPANCY on '%s' with %d SAT %c %d UNSAT", s->name, sat, cmp,
-        unsat);
-    for (e = s->first; e; e = e->chain) {
-      const char *suffix;
-      if (e->res < 10)
+      suffix = "";
+    wrn("%s %s/%s %s%s", (e->res == expected) ? " " : "!", ZUMMARY(e)->path,
+        s->name, (e->res == 10 ? "SAT" : "UNSAT"), suffix);
+    if (e->res != expected)
+      e->dis = 1;
+  }
+  fflush(stdout);
+  return 1;
+}
+
+static void bounddiscrepancy(Symbol *s) {
+  Entry *e, *w = 0, *o1 = 0, *o2 = 0;
+  long obnd, obnd1 = -1, obnd2 = -1;
+  for (e = entry(s->first); e; e = entry(e->chain)) {
+    if (e->dis)
+      continue;
+    if (e->res != 10)
+      continue;
+    if (w && e->bnd >= 0 && w->bnd > e->bnd)
+      w = e;
+    if ((obnd = getoptimum(e)) >= 0) {
+      if (o1 && !o2 && obnd1 != obnd)
+        o2 = e, obnd2 = obnd;
+      if (!o1)
+        o1 = e, obnd1 = obnd;
+    }
+  }
+  if (w) {
+    for (e = entry(s->first); e; e = entry(e->chain)) {
+      if (e->dis)
         continue;
-      assert(e->res == 10 || e->res == 20);
-      if (!expected)
-        suffix = " (tie so assumed wrong)";
-      else if (e->res != expected)
-        suffix = " (overvoted so probably wrong)";
-      else
-        suffix = "";
-      wrn("%s %s/%s %s%s", (e->res == expected) ? " " : "!", e->zummary->path,
-          s->name, (e->res == 10 ? "SAT" : "UNSAT"), suffix);
-      if (e->res != expected)
-        e->dis = 1;
+      if (e->res == 10)
+        continue;
+      assert(e->res != 20);
+      if (e->bnd < w->bnd)
+        continue;
+      wrn("unsat-bound %d in '%s/%s' >= witness length %d in '%s/%s'", e->bnd,
+          ZUMMARY(e)->path, NAME(e), w->bnd, ZUMMARY(w)->path, NAME(w));
+      setubndbroken(e, UBND_GLOBALLY_BROKEN);
     }
-    fflush(stdout);
-    count++;
   }
-  if (count)
-    msg(1, "found %d result discrepancies", count);
-  else
-    msg(1, "no result discrepancies found");
-  count = 0;
-  for (i = 0; i < nsyms; i++) {
-    Symbol *s = symtab[i];
-    Entry *e, *w = 0, *o1 = 0, *o2 = 0;
-    for (e = s->first; e; e = e->chain) {
+  if (o1 && o2) {
+    assert(obnd1 >= 0);
+    assert(obnd2 >= 0);
+    assert(obnd1 != obnd2);
+    wrn("optimum %ld in '%s/%s' does not match %ld in '%s/%s'", obnd1,
+        ZUMMARY(o1)->path, NAME(o1), obnd2, ZUMMARY(o2)->path, NAME(o2));
+    for (e = entry(s->first); e; e = entry(e->chain)) {
       if (e->dis)
         continue;
       if (e->res != 10)
         continue;
-      if (w && e->bnd >= 0 && w->bnd > e->bnd)
-        w = e;
-      if (e->obnd >= 0) {
-        if (o1 && !o2 && o1->obnd != e->obnd)
-          o2 = e;
-        if (!o1)
-          o1 = e;
-      }
-    }
-    if (w) {
-      for (e = s->first; e; e = e->chain) {
-        if (e->dis)
-          continue;
-        if (e->res == 10)
-          continue;
-        assert(e->res != 20);
-        if (e->bnd < w->bnd)
-          continue;
-        wrn("unsat-bound %d in '%s/%s' >= witness length %d in '%s/%s'", e->bnd,
-            e->zummary->path, e->name, w->bnd, w->zummary->path, w->name);
-        setubndbroken(e, UBND_GLOBALLY_BROKEN);
-      }
-    }
-    if (o1 && o2) {
-      assert(o1->obnd >= 0);
-      assert(o2->obnd >= 0);
-      assert(o1->obnd != o2->obnd);
-      wrn("optimum %ld in '%s/%s' does not match %ld in '%s/%s'", o1->obnd,
-          o1->zummary->path, o1->name, o2->obnd, o2->zummary->path, o2->name);
-      for (e = s->first; e; e = e->chain) {
-        if (e->dis)
-          continue;
-        if (e->res != 10)
-          continue;
-        e->dis = 1;
-      }
+      e->dis = 1;
     }
   }
 }
 
+static void reportdiscrepancies(int count) {
+  if (count)
+    msg(1, "found %d result discrepancies", count);
+  else
+    msg(1, "no result discrepancies found");
+}
+
+static void discrepancies() {
+  int i, count = 0;
+  if (noptima)
+    qsort(optima, noptima, sizeof *optima, cmpoptima4qsort);
+  for (i = 0; i < nsyms; i++)
+    count += resultdiscrepancy(symtab[i]);
+  reportdiscrepancies(count);
+  for (i = 0; i < nsyms; i++)
+    bounddiscrepancy(symtab[i]);
+}
+
 static void checklimits() {
   Zummary *x, *y, *z;
   int i;
@@ -2070,53 +4854,69 @@ static void fixzummaries(int zummary_mode) {
     fixzummary(zummaries[i], zummary_mode);
 }
 
-static void computedeep() {
-  int i, count, unsolved;
-  count = unsolved = 0;
-  for (i = 0; i < nsyms; i++) {
-    Symbol *s = symtab[i];
-    count++;
-    if (s->sat)
-      continue;
-    if (s->uns)
-      continue;
-    msg(1, "unsolved instance '%s'", s->name);
-    unsolved++;
-  }
+static int isunsolved(Symbol *s) {
+  if (s->sat)
+    return 0;
+  if (s->uns)
+    return 0;
+  msg(1, "unsolved instance '%s'", s->name);
+  return 1;
+}
+
+static void adddeep(Zummary *z, Entry *e) {
+  int aftercapping;
+  double inc;
+  if (z->ubndbroken)
+    return;
+  if (e->dis)
+    return;
+  if ((aftercapping = e->bnd) < 0)
+    return;
+  if (SYMBOL(e)->sat)
+    return;
+  if (SYMBOL(e)->uns)
+    return;
+  if (aftercapping > capped)
+    aftercapping = capped;
+  inc = 1e5 - 1e5 / (aftercapping + 2.0);
+  z->deep += inc;
+  msg(2, "unsat-bound %d capped to %d in '%s/%s' contributes %.0f", e->bnd,
+      aftercapping, z->path, NAME(e), inc);
+}
+
+static void finishdeep(int count, int unsolved) {
+  int i;
   if (unsolved) {
     msg(1, "found %d unsolved instances out of %d", unsolved, count);
   } else
     msg(1, "all instances solved");
   for (i = 0; i < nzummaries; i++) {
     Zummary *z = zummaries[i];
-    int aftercapping;
-    Entry *e;
     if (z->ubndbroken)
       continue;
-    z->deep = 0;
-    for (e = z->first; e; e = e->next) {
-      double inc;
-      if (e->dis)
-        continue;
-      if ((aftercapping = e->bnd) < 0)
-        continue;
-      if (e->symbol->sat)
-        continue;
-      if (e->symbol->uns)
-        continue;
-      if (aftercapping > capped)
-        aftercapping = capped;
-      inc = 1e5 - 1e5 / (aftercapping + 2.0);
-      z->deep += inc;
-      msg(2, "unsat-bound %d capped to %d in '%s/%s' contributes %.0f", e->bnd,
-          aftercapping, z->path, e->name, inc);
-    }
     if (unsolved > 0)
       z->deep /= (double)unsolved;
     msg(1, "deep score %.0f of '%s'", z->deep, z->path);
   }
 }
 
+static void computedeep() {
+  int i, count, unsolved;
+  count = unsolved = 0;
+  for (i = 0; i < nsyms; i++) {
+    count++;
+    unsolved += isunsolved(symtab[i]);
+  }
+  for (i = 0; i < nzummaries; i++) {
+    Zummary *z = zummaries[i];
+    unsigned j;
+    z->deep = 0;
+    for (j = z->first; j < z->last; j++)
+      adddeep(z, ENTRY(j));
+  }
+  finishdeep(count, unsolved);
+}
+
 static int cmpdouble(double a, double b) {
   if (a < b)
     return -1;
@@ -2125,20 +4925,28 @@ static int cmpdouble(double a, double b) {
   return 0;
 }
 
+static int cmpunsigned(unsigned a, unsigned b) {
+  if (a < b)
+    return -1;
+  if (b < a)
+    return 1;
+  return 0;
+}
+
 static int cmp_entry_resources(Entry *a, Entry *b) {
   int res;
   if (usereal) {
-    if ((res = cmpdouble(a->wll, b->wll)))
+    if ((res = cmpunsigned(a->wll, b->wll)))
       return res;
-    if ((res = cmpdouble(a->tim, b->tim)))
+    if ((res = cmpunsigned(a->tim, b->tim)))
       return res;
   } else {
-    if ((res = cmpdouble(a->tim, b->tim)))
+    if ((res = cmpunsigned(a->tim, b->tim)))
       return res;
-    if ((res = cmpdouble(a->wll, b->wll)))
+    if ((res = cmpunsigned(a->wll, b->wll)))
       return res;
   }
-  if ((res = cmpdouble(a->mem, b->mem)))
+  if ((res = cmpunsigned(a->mem, b->mem)))
     return res;
   return 0;
 }
@@ -2216,28 +5024,32 @@ static int cmp_entry_better(Entry *a, Entry *b) {
   return res;
 }
 
-static void findbest() {
-  int i;
-  for (i = 0; i < nsyms; i++) {
-    Symbol *s = symtab[i];
-    Entry *e, *best = 0;
-    for (e = s->first; e; e = e->chain) {
-      if (e->dis)
-        continue;
-      if (cmp_entry_better(e, best) < 0)
-        best = e;
-      if (e->res == 10)
-        s->sat++;
-      if (e->res == 20)
-        s->uns++;
-    }
-    if (best) {
-      msg(2, "best result '%s/%s.log'", best->zummary->path, best->name);
-      for (e = s->first; e; e = e->chain)
-        e->best = best;
-    } else
-      msg(2, "no result for '%s'", s->name);
+static void findbestsymbol(Symbol *s) {
+  Entry *e, *best = 0;
+  unsigned j;
+  s->best = 0;
+  s->sat = s->uns = 0;
+  for (j = s->first; j; j = e->chain) {
+    e = ENTRY(j);
+    if (e->dis)
+      continue;
+    if (cmp_entry_better(e, best) < 0)
+      best = e, s->best = j;
+    if (e->res == 10)
+      s->sat++;
+    if (e->res == 20)
+      s->uns++;
   }
+  if (best)
+    msg(2, "best result '%s/%s.log'", ZUMMARY(best)->path, NAME(best));
+  else
+    msg(2, "no result for '%s'", s->name);
+}
+
+static void findbest() {
+  int i;
+  for (i = 0; i < nsyms; i++)
+    findbestsymbol(symtab[i]);
 }
 
 static int cmpzummaries4qsort(const void *p, const void *q) {
@@ -2317,14 +5129,192 @@ static int skiprefixlength() {
   return res;
 }
 
+/*------------------------------------------------------------------------*/
+
+/* With '--json' reports are printed as one JSON array and with '--ndjson'
+ * as one JSON object per line.  Records are written while the report is
+ * generated through our own buffer and number formatting, since 'printf'
+ * dominates the time spent on printing large merged or ranked reports.
+ * Every record names its report in the field 'report'.
+ */
+
+#define JSON_ARRAY 1
+#define JSON_LINES 2
+
+static int jsonrecords, jsonfirst;
+
+static void jsonbytes(const char *bytes, size_t n) {
+  writebytes(&output, bytes, n);
+}
+
+static void jsonchar(char ch) { writechar(&output, ch); }
+
+static void jsonstring(const char *str) {
+  const char *p = str, *q;
+  char escaped[8];
+  jsonchar('"');
+  for (;;) {
+    for (q = p; *q && *q != '"' && *q != '\\' && (unsigned char)*q >= 32; q++)
+      ;
+    jsonbytes(p, q - p);
+    if (!*q)
+      break;
+    if (*q == '"' || *q == '\\')
+      escaped[0] = '\\', escaped[1] = *q, escaped[2] = 0;
+    else
+      sprintf(escaped, "\\u%04x", (unsigned char)*q);
+    jsonbytes(escaped, strlen(escaped));
+    p = q + 1;
+  }
+  jsonchar('"');
+}
+
+/* Prints the value rounded to the given number of decimals without
+ * trailing zeros.  Since times are stored in centi-seconds and memory in
+ * tenths of mega-bytes this is exact for the values we print.
+ */
+static void jsonfixed(double d, int decimals) {
+  unsigned long long scale = 1, u, fraction;
+  char digits[32];
+  int i, n;
+  for (i = 0; i < decimals; i++)
+    scale *= 10;
+  if (d != d || d - d != 0) {
+    jsonbytes("null", 4);
+    return;
+  }
+  if (d >= 1e15 || d <= -1e15) {
+    n = sprintf(digits, "%.17g", d);
+    jsonbytes(digits, n);
+    return;
+  }
+  if (d < 0)
+    jsonchar('-'), d = -d;
+  u = d * scale + 0.5;
+  writeunsigned(&output, u / scale);
+  if (!(fraction = u % scale))
+    return;
+  for (n = decimals; !(fraction % 10); n--)
+    fraction /= 10;
+  jsonchar('.');
+  for (i = n; i--; fraction /= 10)
+    digits[i] = '0' + fraction % 10;
+  jsonbytes(digits, n);
+}
+
+static void jsonrecord(const char *report) {
+  if (json == JSON_ARRAY)
+    jsonbytes(jsonrecords ? ",\n" : "[\n", 2);
+  jsonrecords++;
+  jsonbytes("{\"report\":", 10);
+  jsonstring(report);
+  jsonfirst = 0;
+}
+
+static void jsonkey(const char *key) {
+  if (!jsonfirst)
+    jsonchar(',');
+  jsonfirst = 0;
+  jsonstring(key);
+  jsonchar(':');
+}
+
+static void jsonint(const char *key, long long value) {
+  jsonkey(key);
+  if (value < 0)
+    jsonchar('-'), value = -value;
+  writeunsigned(&output, value);
+}
+
+static void jsonnumber(const char *key, double value, int decimals) {
+  jsonkey(key);
+  jsonfixed(value, decimals);
+}
+
+static void jsontext(const char *key, const char *value) {
+  jsonkey(key);
+  jsonstring(value);
+}
+
+static void jsonopen(char bracket) {
+  jsonchar(bracket);
+  jsonfirst = 1;
+}
+
+static void jsonfinish() {
+  jsonchar('}');
+  if (json == JSON_LINES)
+    jsonchar('\n');
+}
+
+static void jsonclose() {
+  if (!json)
+    return;
+  if (json == JSON_ARRAY) {
+    if (jsonrecords)
+      jsonbytes("\n]\n", 3);
+    else
+      jsonbytes("[]\n", 3);
+  }
+  jsonrecords = 0;
+  writeflush(&output);
+  fflush(stdout);
+}
+
+static void jsonzummaries() {
+  int i, skip = skiprefixlength();
+  unsigned j;
+  char parname[16];
+  sprintf(parname, "par%d", par);
+  for (i = 0; i < nzummaries; i++) {
+    Zummary *z = zummaries[i];
+    if (!printall && satonly && !z->sat)
+      continue;
+    if (!printall && unsatonly && !z->uns)
+      continue;
+    if (!printall && deeponly && !z->deep)
+      continue;
+    jsonrecord("table");
+    jsontext("zummary", z->path + skip);
+    jsonint("cnt", z->cnt);
+    jsonint("ok", z->sol);
+    jsonint("sat", z->sat);
+    jsonint("uns", z->uns);
+    jsonint("dis", z->dis);
+    jsonint("fld", z->fld);
+    jsonint("to", z->tio);
+    jsonint("mo", z->meo);
+    jsonint("s11", z->s11);
+    jsonint("s6", z->si6);
+    jsonint("unk", z->unk);
+    jsonnumber("real", z->wll, 2);
+    jsonnumber("time", z->tim, 2);
+    if (par)
+      jsonnumber(parname, z->par, 2);
+    jsonnumber("space", z->mem, 1);
+    jsonnumber("max", z->max, 1);
+    jsonint("best", z->bst);
+    jsonint("uniq", z->unq);
+    jsonnumber("deep", z->deep, 2);
+    for (j = 0; j < nmetrics; j++)
+      jsonnumber(metrics[j].name, z->metrics[j], 2);
+    jsonfinish();
+  }
+}
+
 static void printzummaries() {
+  if (json) {
+    jsonzummaries();
+    return;
+  }
 
   char parname[10];
   sprintf(parname, "par%d", par);
 
   int nam, cnt, sol, sat, uns, dis, fld, tio, meo, s11, si6, unk;
   int wll, tim, par, mem, max, bst, unq, deep;
-  int i, j, skip;
+  int i, j, skip, *metricwidths = 0;
+  unsigned k;
 
   nam = cnt = sol = sat = uns = dis = fld = tio = meo = s11 = si6 = unk = 0;
   wll = tim = par = mem = max = bst = unq = deep = 0;
@@ -2406,6 +5396,15 @@ static void printzummaries() {
   PRINTHEADER(bst, "best");
   PRINTHEADER(unq, "uniq");
   PRINTHEADER(deep, "deep");
+  if (nmetrics && !(metricwidths = malloc(nmetrics * sizeof *metricwidths)))
+    die("out of memory allocating metric widths");
+  for (k = 0; k < nmetrics; k++) {
+    metricwidths[k] = strlen(metrics[k].name);
+    for (i = 0; i < nzummaries; i++)
+      UPDATEIFLARGERAUX(metricwidths[k],
+                        snprintf(0, 0, "%.0f", zummaries[i]->metrics[k]));
+    printf(" %*s", metricwidths[k], metrics[k].name);
+  }
   putc('\n', stdout);
 
   for (i = 0; i < nzummaries; i++) {
@@ -2459,13 +5458,25 @@ static void printzummaries() {
     IPRINTZUMMARY(bst);
     IPRINTZUMMARY(unq);
     FPRINTZUMMARY(deep);
+    for (k = 0; k < nmetrics; k++)
+      printf(" %*.0f", metricwidths[k], z->metrics[k]);
     fputc('\n', stdout);
   }
+  free(metricwidths);
 }
 
 static void printdeep() {
   int i, unsolved;
   FILE *file;
+  if (json) {
+    for (i = 0; i < nsyms; i++)
+      if (!symtab[i]->sat && !symtab[i]->uns) {
+        jsonrecord("deep");
+        jsontext("benchmark", symtab[i]->name);
+        jsonfinish();
+      }
+    return;
+  }
   unsolved = 0;
   for (i = 0; i < nsyms; i++) {
     Symbol *s = symtab[i];
@@ -2489,6 +5500,135 @@ static void printdeep() {
   pclose(file);
 }
 
+static int cmpdouble4qsort(const void *p, const void *q) {
+  double a = *(const double *)p, b = *(const double *)q;
+  return a < b ? -1 : a > b;
+}
+
+/* Nearest rank percentile of the sorted array.
+ */
+static double percentile(const double *a, unsigned n, double p) {
+  unsigned rank = p * n;
+  assert(n);
+  if (rank < p * n)
+    rank++;
+  return a[rank ? rank - 1 : 0];
+}
+
+static int spacefiltered(Entry *e) {
+  Entry *best = entry(SYMBOL(e)->best);
+  if (satonly && (!best || best->res != 10))
+    return 1;
+  if (unsatonly && (!best || best->res != 20))
+    return 1;
+  return 0;
+}
+
+static const unsigned spacefractions[] = {10, 25, 50, 75, 100};
+
+#define NSPACEFRACTIONS (sizeof spacefractions / sizeof *spacefractions)
+
+/* Space profile of each zummary from the captured samples.  For each
+ * fraction of the time limit the percentiles of the peak space which the
+ * runs reached until then are printed.  Runs with a growth rate (from the
+ * first sample to their peak) far above the other runs of the same solver
+ * are listed as outliers, where far above means above the third quartile
+ * plus three times the inter-quartile range.
+ */
+static void printspaceprofile() {
+  double *peaks, *growths, *sorted, q1, q3, fence;
+  unsigned i, j, k, n, m, count, skip = skiprefixlength();
+  size_t bytes;
+  int l;
+  for (l = 0; l < nzummaries; l++) {
+    Zummary *z = zummaries[l];
+    n = z->last - z->first;
+    if (!n)
+      continue;
+    bytes = (NSPACEFRACTIONS + 2) * (size_t)n * sizeof *peaks;
+    if (!(peaks = malloc(bytes)))
+      die("out of memory allocating space profile");
+    temporary(bytes);
+    growths = peaks + NSPACEFRACTIONS * (size_t)n;
+    sorted = growths + n;
+    m = count = 0;
+    for (i = z->first; i < z->last; i++) {
+      unsigned peak = 0, at = 0;
+      Entry *e = ENTRY(i);
+      if (spacefiltered(e) || !(k = decodesamples(i)))
+        continue;
+      for (j = 0; j < NSPACEFRACTIONS; j++) {
+        double cutoff = 10 * z->tlim * spacefractions[j] / 100.0;
+        unsigned max = 0;
+        for (k = 0; k < nsampled; k += 2)
+          if (sampled[k] <= cutoff && sampled[k + 1] > max)
+            max = sampled[k + 1];
+        peaks[j * (size_t)n + m] = max / 10.0;
+      }
+      for (k = 0; k < nsampled; k += 2)
+        if (sampled[k + 1] > peak)
+          peak = sampled[k + 1], at = sampled[k];
+      growths[m++] = at > sampled[0] ? (peak - (double)sampled[1]) /
+                                           (at - (double)sampled[0])
+                                     : 0;
+      count += nsampled / 2;
+    }
+    if (!m) {
+      free(peaks);
+      continue;
+    }
+    if (!json)
+      printf("%sspace profile of '%s' (%u runs, %u samples)\n\n"
+             "%5s %9s %9s %9s %9s\n",
+             l ? "\n" : "", z->path + skip, m, count, "time", "p50", "p90",
+             "p99", "max");
+    for (j = 0; j < NSPACEFRACTIONS; j++) {
+      double *a = peaks + j * (size_t)n;
+      qsort(a, m, sizeof *a, cmpdouble4qsort);
+      if (json) {
+        jsonrecord("space");
+        jsontext("zummary", z->path + skip);
+        jsonint("time", spacefractions[j]);
+        jsonnumber("p50", percentile(a, m, 0.5), 1);
+        jsonnumber("p90", percentile(a, m, 0.9), 1);
+        jsonnumber("p99", percentile(a, m, 0.99), 1);
+        jsonnumber("max", a[m - 1], 1);
+        jsonfinish();
+      } else
+        printf("%4u%% %9.1f %9.1f %9.1f %9.1f\n", spacefractions[j],
+               percentile(a, m, 0.5), percentile(a, m, 0.9),
+               percentile(a, m, 0.99), a[m - 1]);
+    }
+    if (m < 4) {
+      free(peaks);
+      continue;
+    }
+    memcpy(sorted, growths, m * sizeof *sorted);
+    qsort(sorted, m, sizeof *sorted, cmpdouble4qsort);
+    q1 = percentile(sorted, m, 0.25);
+    q3 = percentile(sorted, m, 0.75);
+    fence = q3 + 3 * (q3 - q1);
+    for (i = z->first, k = 0; i < z->last; i++) {
+      Entry *e = ENTRY(i);
+      if (spacefiltered(e) || !hassamples(i))
+        continue;
+      if (growths[k++] <= fence)
+        continue;
+      if (json) {
+        jsonrecord("growth");
+        jsontext("zummary", z->path + skip);
+        jsontext("benchmark", NAME(e));
+        jsonnumber("growth", growths[k - 1], 1);
+        jsonnumber("fence", fence, 1);
+        jsonfinish();
+      } else
+        printf("growth outlier %s %.1f MB/s (fence %.1f MB/s)\n", NAME(e),
+               growths[k - 1], fence);
+    }
+    free(peaks);
+  }
+}
+
 static double ratio(double a, double b) {
   if (!a && !b)
     return 1;
@@ -2499,70 +5639,578 @@ static double ratio(double a, double b) {
   return a / b;
 }
 
-static int cmpcmp4qsort(const void *p1, const void *p2) {
-  Symbol *s1 = *(Symbol **)p1;
-  Symbol *s2 = *(Symbol **)p2;
-  double r1 = ratio(s1->first->tim, s1->last->tim);
-  double r2 = ratio(s2->first->tim, s2->last->tim);
-  if (r1 > r2)
-    return -1;
-  if (r1 < r2)
-    return 1;
-  if (s1->first->tim > s2->first->tim)
-    return -1;
-  if (s1->first->tim > s2->first->tim)
-    return 1;
-  return strcmp(s1->name, s2->name);
+static int cmpcmp4qsort(const void *p1, const void *p2) {
+  Symbol *s1 = *(Symbol **)p1;
+  Symbol *s2 = *(Symbol **)p2;
+  Entry *f1 = ENTRY(s1->first), *f2 = ENTRY(s2->first);
+  double r1 = ratio(TIM(f1), TIM(ENTRY(s1->last)));
+  double r2 = ratio(TIM(f2), TIM(ENTRY(s2->last)));
+  if (r1 > r2)
+    return -1;
+  if (r1 < r2)
+    return 1;
+  if (f1->tim > f2->tim)
+    return -1;
+  if (f1->tim > f2->tim)
+    return 1;
+  return strcmp(s1->name, s2->name);
+}
+
+static void compare() {
+  Symbol **a = malloc(nsyms * sizeof *a);
+  int i, n = 0;
+  if (!a)
+    die("out of memory allocating comparison table");
+  temporary(nsyms * sizeof *a);
+  for (i = 0; i < nsyms; i++) {
+    Symbol *s = symtab[i];
+    Entry *e1 = entry(s->first), *e2 = entry(s->last);
+    if (!e1)
+      continue;
+    assert(e2);
+    int r1 = (e1->res == 10 || e1->res == 20);
+    int r2 = (e2->res == 10 || e2->res == 20);
+    if (satonly && e1->res == 20)
+      continue;
+    if (satonly && e2->res == 20)
+      continue;
+    if (unsatonly && e1->res == 10)
+      continue;
+    if (unsatonly && e2->res == 10)
+      continue;
+    if (nounknown && e1->unk)
+      continue;
+    if (nounknown && e2->unk)
+      continue;
+    if (filter && r1 + r2 != 1)
+      continue;
+    if (!filter && r1 + r2 == 0)
+      continue;
+    a[n++] = s;
+  }
+  qsort(a, n, sizeof *a, cmpcmp4qsort);
+  for (int i = 0; i < n; i++) {
+    Symbol *s = a[i];
+    Entry *e1 = entry(s->first), *e2 = entry(s->last);
+    int r1 = (e1->res == 10 || e1->res == 20);
+    int r2 = (e2->res == 10 || e2->res == 20);
+    double t1, t2;
+    if (usereal) {
+      t1 = r1 ? WLL(e1) : ZUMMARY(e1)->rlim;
+      t2 = r2 ? WLL(e2) : ZUMMARY(e2)->rlim;
+    } else {
+      t1 = r1 ? TIM(e1) : ZUMMARY(e1)->tlim;
+      t2 = r2 ? TIM(e2) : ZUMMARY(e2)->tlim;
+    }
+    if (json) {
+      jsonrecord("cmp");
+      jsontext("benchmark", s->name);
+      jsonnumber("ratio", ratio(t1, t2), 2);
+      jsonnumber("first", t1, 2);
+      jsonnumber("second", t2, 2);
+      jsonfinish();
+    } else
+      printf("%.2f %s %.2f %.2f\n", ratio(t1, t2), s->name, t1, t2);
+  }
+  free(a);
+}
+
+/*------------------------------------------------------------------------*/
+
+/* The '--matrix' report compares all pairs of zummaries.  The instances
+ * solved by a zummary are kept as bit-set over symbol ids.  Then the
+ * number of instances solved by both zummaries of a pair is the
+ * population count of the conjunction of their bit-sets, from which the
+ * number of instances solved by only one of them and their Jaccard
+ * similarity follow.  Rows of this symmetric matrix are distributed over
+ * 'MATRIXTHREADS' threads.
+ */
+
+#ifndef MATRIXTHREADS
+#define MATRIXTHREADS 8
+#endif
+
+static unsigned long long *solvedsets;
+static size_t solvedwords;
+static unsigned *solvedboth, matrixthreads;
+
+static unsigned popcount(unsigned long long word) {
+#ifdef __GNUC__
+  return __builtin_popcountll(word);
+#else
+  unsigned res = 0;
+  for (; word; word &= word - 1)
+    res++;
+  return res;
+#endif
+}
+
+static void *matrixthread(void *p) {
+  unsigned t = *(unsigned *)p, n = nzummaries, i, j, count;
+  const unsigned long long *a, *b;
+  size_t k;
+  for (i = t; i < n; i += matrixthreads) {
+    a = solvedsets + i * solvedwords;
+    for (j = i; j < n; j++) {
+      b = solvedsets + j * solvedwords;
+      for (count = 0, k = 0; k < solvedwords; k++)
+        count += popcount(a[k] & b[k]);
+      solvedboth[i * n + j] = solvedboth[j * n + i] = count;
+    }
+  }
+  return 0;
+}
+
+static int issolved(Entry *e) {
+  if (e->res == 10)
+    return !unsatonly;
+  if (e->res == 20)
+    return !satonly;
+  return 0;
+}
+
+static void printmatrix() {
+  unsigned n = nzummaries, i, j, solvedi, solvedj, both, skip;
+  unsigned indices[MATRIXTHREADS];
+  size_t bytes;
+  int width = 0, len;
+  if (!n)
+    return;
+  skip = skiprefixlength();
+  solvedwords = (nsyms + 63) / 64;
+  bytes = n * solvedwords * sizeof *solvedsets + n * n * sizeof *solvedboth;
+  solvedsets = calloc(n * solvedwords, sizeof *solvedsets);
+  solvedboth = malloc(n * n * sizeof *solvedboth);
+  if (!solvedsets || !solvedboth)
+    die("out of memory allocating solved sets");
+  temporary(bytes);
+  for (i = 0; i < n; i++) {
+    Zummary *z = zummaries[i];
+    unsigned long long *set = solvedsets + i * solvedwords;
+    for (j = z->first; j < z->last; j++) {
+      Entry *e = ENTRY(j);
+      if (issolved(e))
+        set[e->symbol / 64] |= 1ull << (e->symbol % 64);
+    }
+  }
+  matrixthreads = n < MATRIXTHREADS ? n : MATRIXTHREADS;
+  for (i = 0; i < matrixthreads; i++)
+    indices[i] = i;
+#ifndef NTHREADS
+  {
+    pthread_t threads[MATRIXTHREADS];
+    for (i = 1; i < matrixthreads; i++)
+      if (pthread_create(threads + i, 0, matrixthread, indices + i))
+        die("failed to start thread computing matrix");
+    matrixthread(indices);
+    for (i = 1; i < matrixthreads; i++)
+      pthread_join(threads[i], 0);
+  }
+#else
+  for (i = 0; i < matrixthreads; i++)
+    matrixthread(indices + i);
+#endif
+  msg(1, "compared %u pairs of %u solved sets over %u benchmarks",
+      n * (n - 1) / 2, n, nsyms);
+  for (i = 0; i < n; i++)
+    if ((len = strlen(zummaries[i]->path + skip)) > width)
+      width = len;
+  if (!json) {
+    printf("%*s %6s", width + 4, "", "solved");
+    for (j = 0; j < n; j++)
+      printf(" %6u", j + 1);
+    fputc('\n', stdout);
+    for (i = 0; i < n; i++) {
+      printf("%3u %-*s %6u", i + 1, width, zummaries[i]->path + skip,
+             solvedboth[i * n + i]);
+      for (j = 0; j < n; j++)
+        if (i == j)
+          printf(" %6s", "-");
+        else
+          printf(" %6u", solvedboth[i * n + i] - solvedboth[i * n + j]);
+      fputc('\n', stdout);
+    }
+    printf("\n%*s", width + 4, "");
+    for (j = 0; j < n; j++)
+      printf(" %6u", j + 1);
+    fputc('\n', stdout);
+  }
+  for (i = 0; i < n; i++) {
+    if (!json)
+      printf("%3u %-*s", i + 1, width, zummaries[i]->path + skip);
+    for (j = 0; j < n; j++) {
+      double jaccard;
+      solvedi = solvedboth[i * n + i];
+      solvedj = solvedboth[j * n + j];
+      both = solvedboth[i * n + j];
+      jaccard = solvedi + solvedj > both
+                    ? both / (double)(solvedi + solvedj - both)
+                    : 1;
+      if (!json)
+        printf(" %6.3f", jaccard);
+      else if (i != j) {
+        jsonrecord("matrix");
+        jsontext("row", zummaries[i]->path + skip);
+        jsontext("column", zummaries[j]->path + skip);
+        jsonint("exclusive", solvedi - both);
+        jsonint("both", both);
+        jsonnumber("jaccard", jaccard, 3);
+        jsonfinish();
+      }
+    }
+    if (!json)
+      fputc('\n', stdout);
+  }
+  free(solvedsets);
+  free(solvedboth);
+  solvedsets = 0, solvedboth = 0;
+}
+
+/*------------------------------------------------------------------------*/
+
+/* The '--portfolio <k>' report selects 'k' zummaries, which together, that
+ * is taking the best of their entries for each instance, solve the most
+ * instances with the least time, or with '--par<x>' have the smallest PAR
+ * score.  Each zummary is a column of times over symbol ids, where failed
+ * instances have time 'FAILED' and instances without entry (or with a
+ * discrepancy) infinite time.  Thus, as for '--par<x>' of a single zummary,
+ * only instances attempted and failed on are penalized.  Evaluating a
+ * candidate then is a minimum reduction of its column with the column of
+ * the portfolio so far, which the compiler vectorizes.  If the number of
+ * evaluations is small enough all subsets of size 'k' are searched,
+ * otherwise they are selected greedily by their marginal gain.  The virtual
+ * best solver (VBS) of all zummaries is printed for reference.
+ */
+
+#ifndef PORTFOLIO_EXACT
+#define PORTFOLIO_EXACT (1 << 27) // maximum number of exact time updates
+#endif
+
+#define FAILED DBL_MAX
+
+static double *columns, *bestcolumn, penalty;
+static unsigned ncolumns;
+
+static void mincolumns(double *res, const double *a, const double *b) {
+  unsigned i;
+  for (i = 0; i < nsyms; i++)
+    res[i] = a[i] < b[i] ? a[i] : b[i];
+}
+
+static Score scorecolumn(const double *a) {
+  unsigned i, solved = 0, failed = 0;
+  double time = 0;
+  Score res;
+  for (i = 0; i < nsyms; i++)
+    if (a[i] < FAILED)
+      solved++, time += a[i];
+    else
+      failed += a[i] == FAILED;
+  res.solved = solved;
+  res.time = time;
+  res.par = time + penalty * failed;
+  return res;
+}
+
+/* Same as 'scorecolumn(min(a,b))' without storing the minimum.
+ */
+static Score scoremin(const double *a, const double *b) {
+  unsigned i, solved = 0, failed = 0;
+  double time = 0, t;
+  Score res;
+  for (i = 0; i < nsyms; i++) {
+    t = a[i] < b[i] ? a[i] : b[i];
+    if (t < FAILED)
+      solved++, time += t;
+    else
+      failed += t == FAILED;
+  }
+  res.solved = solved;
+  res.time = time;
+  res.par = time + penalty * failed;
+  return res;
+}
+
+static int betterscore(Score a, Score b) {
+  if (par)
+    return a.par < b.par;
+  if (a.solved != b.solved)
+    return a.solved > b.solved;
+  return a.time < b.time;
+}
+
+/* Enumerates subsets of size 'k' in lexicographic order, where 'stack'
+ * holds the minimum columns of the prefixes of the current subset.
+ */
+static void searchportfolio(unsigned depth, unsigned start, unsigned k,
+                            unsigned *current, unsigned *best,
+                            Score *bestscore, double *stack) {
+  const double *prev = depth ? stack + (depth - 1) * (size_t)nsyms : 0;
+  unsigned c;
+  Score score;
+  for (c = start; c + k - depth <= ncolumns; c++) {
+    const double *column = columns + c * (size_t)nsyms;
+    current[depth] = c;
+    if (depth + 1 == k) {
+      score = prev ? scoremin(prev, column) : scorecolumn(column);
+      if (betterscore(score, *bestscore)) {
+        *bestscore = score;
+        memcpy(best, current, k * sizeof *best);
+      }
+    } else {
+      double *next = stack + depth * (size_t)nsyms;
+      if (prev)
+        mincolumns(next, prev, column);
+      else
+        memcpy(next, column, nsyms * sizeof *next);
+      searchportfolio(depth + 1, c + 1, k, current, best, bestscore, stack);
+    }
+  }
+}
+
+/* Orders the selected zummaries, or all if 'selected' is zero, greedily by
+ * marginal gain and returns the scores after each step.
+ */
+static void greedyportfolio(unsigned k, const unsigned *selected,
+                            unsigned *order, Score *scores) {
+  unsigned step, i, c, best;
+  char *used = calloc(ncolumns, 1);
+  Score score, bestscore;
+  if (!used)
+    die("out of memory allocating portfolio");
+  for (i = 0; i < nsyms; i++)
+    bestcolumn[i] = INFINITY;
+  for (step = 0; step < k; step++) {
+    best = UINT_MAX;
+    bestscore.solved = 0, bestscore.time = bestscore.par = INFINITY;
+    for (i = 0; i < (selected ? k : ncolumns); i++) {
+      c = selected ? selected[i] : i;
+      if (used[c])
+        continue;
+      score = scoremin(bestcolumn, columns + c * (size_t)nsyms);
+      if (best == UINT_MAX || betterscore(score, bestscore))
+        best = c, bestscore = score;
+    }
+    assert(best != UINT_MAX);
+    used[best] = 1;
+    order[step] = best;
+    scores[step] = bestscore;
+    mincolumns(bestcolumn, bestcolumn, columns + best * (size_t)nsyms);
+  }
+  free(used);
+}
+
+static void printportfolio() {
+  unsigned k = portfolio, i, j, skip = skiprefixlength(), *order, *best;
+  double combinations = 1, updates = 0, *t;
+  Score *scores, vbs, bestscore;
+  char parname[16];
+  size_t bytes;
+  int exact;
+  Zummary *z;
+  Entry *e;
+  if (!nzummaries)
+    return;
+  ncolumns = nzummaries;
+  if (k > ncolumns)
+    k = ncolumns;
+  bytes = (ncolumns + 1 + k) * (size_t)nsyms * sizeof *columns;
+  columns = malloc((ncolumns + 1) * (size_t)nsyms * sizeof *columns);
+  order = malloc(2 * k * sizeof *order);
+  scores = malloc(k * sizeof *scores);
+  if (!columns || !order || !scores)
+    die("out of memory allocating portfolio columns");
+  best = order + k;
+  bestcolumn = columns + ncolumns * (size_t)nsyms;
+  for (i = 0; i < ncolumns * nsyms; i++)
+    columns[i] = INFINITY;
+  for (i = 0; i < ncolumns; i++) {
+    z = zummaries[i];
+    for (j = z->first; j < z->last; j++) {
+      e = ENTRY(j);
+      if (e->res == 4 || !projected(e))
+        continue;
+      t = columns + i * (size_t)nsyms + e->symbol;
+      if (e->res == 10 || e->res == 20)
+        *t = usereal ? WLL(e) : TIM(e);
+      else
+        *t = FAILED;
+    }
+  }
+  z = zummaries[0];
+  penalty = par * (usereal ? z->rlim : z->tlim);
+  for (i = 1; i <= k; i++) {
+    combinations = combinations * (ncolumns - i + 1) / i;
+    updates += combinations;
+  }
+  exact = k > 1 && updates * nsyms <= PORTFOLIO_EXACT;
+  if (exact) {
+    double *stack = malloc(k * (size_t)nsyms * sizeof *stack);
+    unsigned *current = malloc(k * sizeof *current);
+    if (!stack || !current)
+      die("out of memory allocating portfolio search");
+    temporary(bytes);
+    bestscore.solved = 0, bestscore.time = bestscore.par = INFINITY;
+    for (i = 0; i < k; i++)
+      best[i] = i;
+    searchportfolio(0, 0, k, current, best, &bestscore, stack);
+    free(current);
+    free(stack);
+    msg(1, "searched %.0f portfolios of %u out of %u runs", combinations, k,
+        ncolumns);
+    greedyportfolio(k, best, order, scores);
+  } else {
+    temporary(bytes - k * (size_t)nsyms * sizeof *columns);
+    greedyportfolio(k, 0, order, scores);
+  }
+  for (i = 0; i < nsyms; i++)
+    bestcolumn[i] = INFINITY;
+  for (i = 0; i < ncolumns; i++)
+    mincolumns(bestcolumn, bestcolumn, columns + i * (size_t)nsyms);
+  vbs = scorecolumn(bestcolumn);
+  sprintf(parname, "par%d", par);
+  if (!json) {
+    printf("%s portfolio of %u out of %u runs\n\n", exact ? "best" : "greedy",
+           k, ncolumns);
+    printf("step %-20s %7s %7s %10s", "run", "solved", "gain", "time");
+    if (par)
+      printf(" %10s", parname);
+    fputc('\n', stdout);
+  }
+  for (i = 0; i < k; i++) {
+    unsigned gain = scores[i].solved - (i ? scores[i - 1].solved : 0);
+    const char *name = zummaries[order[i]]->path + skip;
+    if (json) {
+      jsonrecord("portfolio");
+      jsonint("step", i + 1);
+      jsontext("zummary", name);
+      jsonint("solved", scores[i].solved);
+      jsonint("gain", gain);
+      jsonnumber("time", scores[i].time, 2);
+      if (par)
+        jsonnumber(parname, scores[i].par, 2);
+      jsonfinish();
+    } else {
+      printf("%4u %-20s %7u %7u %10.2f", i + 1, name, scores[i].solved, gain,
+             scores[i].time);
+      if (par)
+        printf(" %10.2f", scores[i].par);
+      fputc('\n', stdout);
+    }
+  }
+  if (json) {
+    jsonrecord("vbs");
+    jsonint("solved", vbs.solved);
+    jsonnumber("time", vbs.time, 2);
+    if (par)
+      jsonnumber(parname, vbs.par, 2);
+    jsonfinish();
+  } else {
+    printf("%4s %-20s %7u %7s %10.2f", "vbs", "", vbs.solved, "",
+           vbs.time);
+    if (par)
+      printf(" %10.2f", vbs.par);
+    fputc('\n', stdout);
+  }
+  free(columns);
+  free(order);
+  free(scores);
+  columns = bestcolumn = 0;
+}
+
+/*------------------------------------------------------------------------*/
+
+/* The '--sweep <limits>' report evaluates each zummary at several time
+ * limits at once.  The times of solved entries are sorted once, and then
+ * the number of entries solved within a limit is found by binary search
+ * and their time is a prefix sum.  Unsolved entries, including those
+ * solved after the limit, add the PAR penalty.  Limits are capped at the
+ * limit of the zummary, since longer runs are not known, and the capped
+ * limit is printed.
+ */
+
+#define MAXSWEEP 64
+
+static unsigned parsesweep(double *limits) {
+  const char *p = sweep, *end;
+  unsigned n = 0;
+  for (;;) {
+    if (n == MAXSWEEP)
+      die("more than %d limits in '--sweep %s'", MAXSWEEP, sweep);
+    limits[n] = parsedecimal(p, p + strcspn(p, ","), &end);
+    if (end == p || limits[n] <= 0 || (*end && *end != ','))
+      die("invalid limits in '--sweep %s'", sweep);
+    n++;
+    if (!*end)
+      return n;
+    p = end + 1;
+  }
 }
 
-static void compare() {
-  Symbol **a = malloc(nsyms * sizeof *a);
-  int i, n = 0;
-  if (!a)
-    die("out of memory allocating comparison table");
-  for (i = 0; i < nsyms; i++) {
-    Symbol *s = symtab[i];
-    Entry *e1 = s->first, *e2 = s->last;
-    if (!e1)
-      continue;
-    assert(e2);
-    int r1 = (e1->res == 10 || e1->res == 20);
-    int r2 = (e2->res == 10 || e2->res == 20);
-    if (satonly && e1->res == 20)
-      continue;
-    if (satonly && e2->res == 20)
-      continue;
-    if (unsatonly && e1->res == 10)
-      continue;
-    if (unsatonly && e2->res == 10)
-      continue;
-    if (nounknown && e1->unk)
-      continue;
-    if (nounknown && e2->unk)
-      continue;
-    if (filter && r1 + r2 != 1)
-      continue;
-    if (!filter && r1 + r2 == 0)
-      continue;
-    a[n++] = s;
+static void printsweep() {
+  static const int ks[] = {1, 2, 10};
+  unsigned nks = sizeof ks / sizeof *ks, nlimits, i, j, n, m, lo, hi;
+  unsigned skip = skiprefixlength();
+  double limits[MAXSWEEP], *times, *sums, limit, zlimit, score;
+  char parname[16];
+  int l, k;
+  nlimits = parsesweep(limits);
+  if (!json) {
+    printf("%-20s %8s %7s %10s", "run", "limit", "solved", "time");
+    for (k = 0; k < (int)nks; k++) {
+      sprintf(parname, "par%d", ks[k]);
+      printf(" %10s", parname);
+    }
+    fputc('\n', stdout);
   }
-  qsort(a, n, sizeof *a, cmpcmp4qsort);
-  for (int i = 0; i < n; i++) {
-    Symbol *s = a[i];
-    Entry *e1 = s->first, *e2 = s->last;
-    int r1 = (e1->res == 10 || e1->res == 20);
-    int r2 = (e2->res == 10 || e2->res == 20);
-    double t1, t2;
-    if (usereal) {
-      t1 = r1 ? e1->wll : e1->zummary->rlim;
-      t2 = r2 ? e2->wll : e2->zummary->rlim;
-    } else {
-      t1 = r1 ? e1->tim : e1->zummary->tlim;
-      t2 = r2 ? e2->tim : e2->zummary->tlim;
+  for (l = 0; l < nzummaries; l++) {
+    Zummary *z = zummaries[l];
+    n = z->last - z->first;
+    if (!(times = malloc(2 * (n + 1) * sizeof *times)))
+      die("out of memory allocating sweep");
+    temporary(2 * (n + 1) * sizeof *times);
+    sums = times + n + 1;
+    for (i = z->first, m = 0; i < z->last; i++) {
+      Entry *e = ENTRY(i);
+      if (issolved(e))
+        times[m++] = usereal ? WLL(e) : TIM(e);
+    }
+    qsort(times, m, sizeof *times, cmpdouble4qsort);
+    for (sums[0] = 0, i = 0; i < m; i++)
+      sums[i + 1] = sums[i] + times[i];
+    zlimit = usereal ? z->rlim : z->tlim;
+    for (j = 0; j < nlimits; j++) {
+      limit = limits[j] < zlimit ? limits[j] : zlimit;
+      for (lo = 0, hi = m; lo < hi;) {
+        unsigned mid = lo + (hi - lo) / 2;
+        if (times[mid] <= limit)
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      if (json) {
+        jsonrecord("sweep");
+        jsontext("zummary", z->path + skip);
+        jsonnumber("limit", limit, 2);
+        jsonint("solved", lo);
+        jsonnumber("time", sums[lo], 2);
+      } else
+        printf("%-20s %8.2f %7u %10.2f", z->path + skip, limit, lo, sums[lo]);
+      for (k = 0; k < (int)nks; k++) {
+        score = sums[lo] + ks[k] * limit * (m - lo + z->fld);
+        if (json) {
+          sprintf(parname, "par%d", ks[k]);
+          jsonnumber(parname, score, 2);
+        } else
+          printf(" %10.2f", score);
+      }
+      if (json)
+        jsonfinish();
+      else
+        fputc('\n', stdout);
     }
-    printf("%.2f %s %.2f %.2f\n", ratio(t1, t2), s->name, t1, t2);
+    free(times);
   }
-  free(a);
 }
 
 static void plot() {
@@ -2616,8 +6264,9 @@ static void plot() {
     z = zummaries[i];
     if (!z->cnt)
       continue;
+    Entry *e, *best;
+    unsigned j;
     int printed;
-    Entry *e;
     if (satonly && !z->sat)
       continue;
     if (unsatonly && !z->uns)
@@ -2627,8 +6276,10 @@ static void plot() {
     c++;
     fprintf(rscriptfile, "z%d=", c);
     printed = 0;
-    for (e = z->first; e; e = e->next) {
+    for (j = z->first; j < z->last; j++) {
       double t;
+      e = ENTRY(j);
+      best = entry(SYMBOL(e)->best);
       if (!deeponly && e->res != 10 && e->res != 20)
         continue;
       if (unsatonly && e->res != 20)
@@ -2638,12 +6289,12 @@ static void plot() {
       if (deeponly) {
         if (e->bnd < 0)
           continue;
-        if (e->best && e->best->res == 10)
+        if (best && best->res == 10)
           continue;
-        if (e->best && e->best->res == 20)
+        if (best && best->res == 20)
           continue;
       }
-      t = usereal ? e->wll : e->tim;
+      t = usereal ? WLL(e) : TIM(e);
       if (printed++)
         fprintf(rscriptfile, ",");
       else
@@ -2786,275 +6437,1641 @@ static void plot() {
   }
 }
 
-static void printmerged() {
-  int skip = skiprefixlength(), i;
-  for (i = 0; i < nsyms; i++) {
-    Symbol *s = symtab[i];
-    Entry *e;
-    if (!i) {
-      printf("benchmark");
-      for (e = s->first; e; e = e->chain) {
-        printf(";solver");
-        printf(";status");
-        printf(";bound");
-        printf(";real");
-        printf(";time");
-        printf(";mem");
-      }
-      printf("\n");
-    }
-    printf("%s", s->name);
-    for (e = s->first; e; e = e->chain) {
-      printf(";%s", e->zummary->path + skip);
-      assert(e->res != 4);
-      switch (e->res) {
-      case 1:
-        printf(";time");
-        break;
-      case 2:
-        printf(";mem");
-        break;
-      case 5:
-        printf(";s11");
-        break;
-      case 6:
-        printf(";s6");
-        break;
-      case 10:
-        printf(";sat");
-        break;
-      case 20:
-        printf(";uns");
-        break;
-      default:
-        assert(e->res == 3);
-      case 3:
-        printf(";unk");
+static void printmergedheader(Symbol *s) {
+  Writer *w = &output;
+  unsigned j;
+  Entry *e;
+  if (json)
+    return;
+  writestr(w, "benchmark");
+  for (e = entry(s->first); e; e = entry(e->chain)) {
+    writestr(w, ";solver;status;bound;real;time;mem");
+    for (j = 0; j < nmetrics; j++) {
+      writechar(w, ';');
+      writestr(w, metrics[j].name);
+    }
+  }
+  writechar(w, '\n');
+}
+
+static const char *mergedstatus(Entry *e) {
+  assert(e->res != 4);
+  switch (e->res) {
+  case 1:
+    return "time";
+  case 2:
+    return "mem";
+  case 5:
+    return "s11";
+  case 6:
+    return "s6";
+  case 10:
+    return "sat";
+  case 20:
+    return "uns";
+  default:
+    assert(e->res == 3);
+    return "unk";
+  }
+}
+
+static void jsonmergedsymbol(Symbol *s, int skip) {
+  unsigned idx, j;
+  Entry *e;
+  jsonrecord("merge");
+  jsontext("benchmark", s->name);
+  jsonkey("entries");
+  jsonchar('[');
+  for (idx = s->first; idx; idx = e->chain) {
+    e = ENTRY(idx);
+    if (idx != s->first)
+      jsonchar(',');
+    jsonopen('{');
+    jsontext("solver", ZUMMARY(e)->path + skip);
+    jsontext("status", mergedstatus(e));
+    jsonint("bound", e->bnd);
+    jsonnumber("real", WLL(e), 2);
+    jsonnumber("time", TIM(e), 2);
+    jsonnumber("mem", MEM(e), 1);
+    for (j = 0; j < nmetrics; j++)
+      jsonnumber(metrics[j].name, VALUE(idx, j), 6);
+    jsonchar('}');
+  }
+  jsonchar(']');
+  jsonfinish();
+}
+
+static void printmergedsymbol(Symbol *s, int skip) {
+  Writer *w = &output;
+  unsigned idx, j;
+  Entry *e;
+  if (json) {
+    jsonmergedsymbol(s, skip);
+    return;
+  }
+  writestr(w, s->name);
+  for (idx = s->first; idx; idx = e->chain) {
+    e = ENTRY(idx);
+    writechar(w, ';');
+    writestr(w, ZUMMARY(e)->path + skip);
+    writechar(w, ';');
+    writestr(w, mergedstatus(e));
+    writechar(w, ';');
+    writeint(w, e->bnd);
+    writechar(w, ';');
+    writefixed(w, WLL(e), 2);
+    writechar(w, ';');
+    writefixed(w, TIM(e), 2);
+    writechar(w, ';');
+    writefixed(w, MEM(e), 1);
+    for (j = 0; j < nmetrics; j++) {
+      writechar(w, ';');
+      if (!isnan(VALUE(idx, j)))
+        writedouble(w, VALUE(idx, j));
+    }
+  }
+  writechar(w, '\n');
+}
+
+static void printmerged() {
+  int skip = skiprefixlength(), i;
+  for (i = 0; i < nsyms; i++) {
+    Symbol *s = symtab[i];
+    if (!i)
+      printmergedheader(s);
+    printmergedsymbol(s, skip);
+  }
+  writeflush(&output);
+}
+
+/*------------------------------------------------------------------------*/
+
+/* The merged table can also be written as Arrow IPC file, such that it can
+ * be memory mapped by analysis tools instead of parsing the text output.
+ * The only column shared by all solvers is the dictionary encoded
+ * benchmark name.  Then each solver has the columns 'status' (dictionary
+ * encoded with one dictionary shared by all solvers), 'bound', 'real',
+ * 'time', 'mem' and one column for each '--metric' prefixed by its name.
+ * Missing entries are null and the validity bitmap of a solver is shared
+ * by all its columns, while missing metric values are NaN.
+ *
+ * Metadata in Arrow are flatbuffers, which we generate directly here.
+ * Tables, vectors and strings are always allocated after the slot which
+ * refers to them, since offsets in flatbuffers have to point forward.
+ * Tables are preceded by their virtual table and their fields are stored
+ * in order and aligned to their size.  Column data is written in host byte
+ * order (which is recorded in the schema) and padded to eight bytes.
+ */
+
+#define ARROW_INT 2
+#define ARROW_FLOAT 3
+#define ARROW_UTF8 5
+
+#define ARROW_SCHEMA 1
+#define ARROW_DICTIONARY 2
+#define ARROW_RECORD 3
+
+#define ARROW_VERSION 4 /* 'V5' */
+
+static const char *arrowstatus[] = {"time", "mem", "s11", "s6",
+                                    "sat",  "uns", "unk"};
+
+static size_t flatalloc(Flat *f, size_t bytes, size_t align) {
+  size_t pos = (f->size + align - 1) & ~(align - 1);
+  if (pos + bytes > f->capacity) {
+    f->capacity = f->capacity ? 2 * f->capacity : 1024;
+    if (f->capacity < pos + bytes)
+      f->capacity = pos + bytes;
+    if (!(f->bytes = realloc(f->bytes, f->capacity)))
+      die("out of memory reallocating flatbuffer");
+  }
+  memset(f->bytes + f->size, 0, pos + bytes - f->size);
+  f->size = pos + bytes;
+  return pos;
+}
+
+static void flatput(Flat *f, size_t pos, unsigned long long u, int bytes) {
+  int i;
+  for (i = 0; i < bytes; i++)
+    f->bytes[pos + i] = (u >> (8 * i)) & 255;
+}
+
+static void flatlink(Flat *f, size_t from, size_t to) {
+  assert(from < to);
+  flatput(f, from, to - from, 4);
+}
+
+static size_t flattable(Flat *f, size_t from, int n, const int *sizes,
+                        size_t *pos) {
+  size_t vtable, table, offset = 4;
+  int i;
+  vtable = flatalloc(f, 4 + 2 * n, 2);
+  for (i = 0; i < n; i++) {
+    if (!sizes[i])
+      continue;
+    offset = (offset + sizes[i] - 1) & ~(size_t)(sizes[i] - 1);
+    flatput(f, vtable + 4 + 2 * i, offset, 2);
+    offset += sizes[i];
+  }
+  flatput(f, vtable, 4 + 2 * n, 2);
+  flatput(f, vtable + 2, offset, 2);
+  table = flatalloc(f, offset, 8);
+  flatput(f, table, table - vtable, 4);
+  for (i = 0; i < n; i++)
+    if (sizes[i])
+      pos[i] = table + f->bytes[vtable + 4 + 2 * i] +
+               256 * f->bytes[vtable + 5 + 2 * i];
+  flatlink(f, from, table);
+  return table;
+}
+
+static size_t flatvector(Flat *f, size_t from, unsigned n, int size) {
+  size_t align = size < 8 ? 4 : 8, res;
+  while ((f->size + 4) & (align - 1))
+    flatalloc(f, 1, 1);
+  flatput(f, flatalloc(f, 4, 4), n, 4);
+  res = flatalloc(f, (size_t)n * size, align);
+  flatlink(f, from, res - 4);
+  return res;
+}
+
+static void flatstring(Flat *f, size_t from, const char *str) {
+  size_t len = strlen(str), pos = flatalloc(f, 4 + len + 1, 4);
+  flatput(f, pos, len, 4);
+  memcpy(f->bytes + pos + 4, str, len);
+  flatlink(f, from, pos);
+}
+
+static void flatint(Flat *f, size_t from, int bits) {
+  static const int sizes[] = {4, 1};
+  size_t pos[2];
+  flattable(f, from, 2, sizes, pos);
+  flatput(f, pos[0], bits, 4);
+  flatput(f, pos[1], 1, 1);
+}
+
+static void flatfield(Flat *f, size_t from, const char *name, int type,
+                      int bits, int dictionary) {
+  int sizes[] = {4, 1, 1, 4, dictionary < 0 ? 0 : 4, 4};
+  static const int dictionarysizes[] = {8, 4};
+  static const int floatsizes[] = {2};
+  size_t pos[6], sub[2];
+  flattable(f, from, 6, sizes, pos);
+  flatstring(f, pos[0], name);
+  flatput(f, pos[1], 1, 1);
+  flatput(f, pos[2], type, 1);
+  if (type == ARROW_INT)
+    flatint(f, pos[3], bits);
+  else if (type == ARROW_FLOAT) {
+    flattable(f, pos[3], 1, floatsizes, sub);
+    flatput(f, sub[0], 2, 2); /* 'DOUBLE' */
+  } else
+    flattable(f, pos[3], 0, 0, 0);
+  if (dictionary >= 0) {
+    flattable(f, pos[4], 2, dictionarysizes, sub);
+    flatput(f, sub[0], dictionary, 8);
+    flatint(f, sub[1], bits);
+  }
+  flatvector(f, pos[5], 0, 4);
+}
+
+static int bigendian() {
+  unsigned u = 1;
+  return !*(unsigned char *)&u;
+}
+
+static void flatschema(Flat *f, size_t from, int skip) {
+  static const int sizes[] = {2, 4};
+  static const char *columns[] = {"bound", "real", "time", "mem"};
+  size_t pos[2], fields, longest = 6;
+  char *name;
+  unsigned j;
+  int i;
+  for (j = 0; j < nmetrics; j++)
+    if (strlen(metrics[j].name) > longest)
+      longest = strlen(metrics[j].name);
+  flattable(f, from, 2, sizes, pos);
+  flatput(f, pos[0], bigendian(), 2);
+  fields = flatvector(f, pos[1], 1 + (5 + nmetrics) * nzummaries, 4);
+  flatfield(f, fields, "benchmark", ARROW_UTF8, 32, 0);
+  for (i = 0; i < nzummaries; i++) {
+    const char *path = zummaries[i]->path + skip;
+    name = malloc(strlen(path) + longest + 2);
+    if (!name)
+      die("out of memory allocating field name");
+    sprintf(name, "%s/status", path);
+    fields += 4;
+    flatfield(f, fields, name, ARROW_UTF8, 8, 1);
+    for (j = 0; j < 4; j++) {
+      sprintf(name, "%s/%s", path, columns[j]);
+      fields += 4;
+      flatfield(f, fields, name, j ? ARROW_FLOAT : ARROW_INT, 32, -1);
+    }
+    for (j = 0; j < nmetrics; j++) {
+      sprintf(name, "%s/%s", path, metrics[j].name);
+      fields += 4;
+      flatfield(f, fields, name, ARROW_FLOAT, 32, -1);
+    }
+    free(name);
+  }
+}
+
+static size_t flatmessage(Flat *f, int type, unsigned long long bodylength) {
+  static const int sizes[] = {2, 1, 4, 8};
+  size_t pos[4];
+  f->size = 0;
+  flattable(f, flatalloc(f, 4, 8), 4, sizes, pos);
+  flatput(f, pos[0], ARROW_VERSION, 2);
+  flatput(f, pos[1], type, 1);
+  flatput(f, pos[3], bodylength, 8);
+  return pos[2];
+}
+
+/* Record batches with a single node for each column and the offsets and
+ * lengths of all their buffers.
+ */
+static void flatbatch(Flat *f, size_t from, unsigned long long length,
+                      unsigned nnodes, const unsigned long long *nodes,
+                      unsigned nbuffers, const unsigned long long *buffers) {
+  static const int sizes[] = {8, 4, 4};
+  size_t pos[3], vector;
+  unsigned i;
+  flattable(f, from, 3, sizes, pos);
+  flatput(f, pos[0], length, 8);
+  vector = flatvector(f, pos[1], nnodes, 16);
+  for (i = 0; i < 2 * nnodes; i++)
+    flatput(f, vector + 8 * i, nodes[i], 8);
+  vector = flatvector(f, pos[2], nbuffers, 16);
+  for (i = 0; i < 2 * nbuffers; i++)
+    flatput(f, vector + 8 * i, buffers[i], 8);
+}
+
+static void flatdictionary(Flat *f, int id, unsigned long long length,
+                           unsigned long long bytes,
+                           unsigned long long bodylength) {
+  static const int sizes[] = {8, 4};
+  unsigned long long nodes[2], buffers[6];
+  size_t pos[2];
+  flattable(f, flatmessage(f, ARROW_DICTIONARY, bodylength), 2, sizes, pos);
+  flatput(f, pos[0], id, 8);
+  nodes[0] = length, nodes[1] = 0;
+  buffers[0] = buffers[1] = 0;
+  buffers[2] = 0, buffers[3] = 4 * (length + 1);
+  buffers[4] = (buffers[3] + 7) & ~7ull, buffers[5] = bytes;
+  flatbatch(f, pos[1], length, 1, nodes, 3, buffers);
+}
+
+typedef struct Block {
+  unsigned long long offset, metadata, body;
+} Block;
+
+static unsigned long long arrowposition;
+
+static void writearrowbytes(FILE *file, const void *bytes, size_t n) {
+  if (n && fwrite(bytes, n, 1, file) != 1)
+    die("failed to write '%s'", arrowpath);
+  arrowposition += n;
+}
+
+static void writearrowpadding(FILE *file) {
+  static const char zeros[8];
+  writearrowbytes(file, zeros, (8 - arrowposition % 8) % 8);
+}
+
+static void writearrowmessage(FILE *file, Flat *f, Block *b) {
+  unsigned char prefix[8];
+  size_t size = (f->size + 7) & ~(size_t)7;
+  int i;
+  while (f->size < size)
+    flatalloc(f, 1, 1);
+  for (i = 0; i < 4; i++)
+    prefix[i] = 255, prefix[4 + i] = (size >> (8 * i)) & 255;
+  if (b)
+    b->offset = arrowposition, b->metadata = 8 + size;
+  writearrowbytes(file, prefix, 8);
+  writearrowbytes(file, f->bytes, f->size);
+}
+
+static void writearrowstrings(FILE *file, Flat *f, int id, unsigned n,
+                              const char **strings, Block *b) {
+  unsigned long long bytes = 0, body;
+  unsigned i;
+  int *offsets;
+  for (i = 0; i < n; i++)
+    bytes += strlen(strings[i]);
+  if (bytes > INT_MAX)
+    die("benchmark names too long for '%s'", arrowpath);
+  body = ((4ull * (n + 1) + 7) & ~7ull) + ((bytes + 7) & ~7ull);
+  flatdictionary(f, id, n, bytes, body);
+  writearrowmessage(file, f, b);
+  b->body = body;
+  if (!(offsets = malloc(4 * (n + 1))))
+    die("out of memory allocating string offsets");
+  offsets[0] = 0;
+  for (i = 0; i < n; i++)
+    offsets[i + 1] = offsets[i] + strlen(strings[i]);
+  writearrowbytes(file, offsets, 4 * (n + 1));
+  writearrowpadding(file);
+  free(offsets);
+  for (i = 0; i < n; i++)
+    writearrowbytes(file, strings[i], strlen(strings[i]));
+  writearrowpadding(file);
+}
+
+static int arrowstatuscode(int res) {
+  switch (res) {
+  case 1:
+    return 0;
+  case 2:
+    return 1;
+  case 5:
+    return 2;
+  case 6:
+    return 3;
+  case 10:
+    return 4;
+  case 20:
+    return 5;
+  default:
+    return 6;
+  }
+}
+
+static void writearrow() {
+  const unsigned long long n = nsyms;
+  const unsigned long long validity = (n + 7) / 8;
+  const unsigned long long vbytes = (validity + 7) & ~7ull;
+  const int skip = skiprefixlength();
+  const unsigned m = 5 + nmetrics; /* columns per solver */
+  unsigned long long *nodes, *buffers, offset, body;
+  unsigned *cells, *nulls, i, j, k, idx;
+  unsigned char *column;
+  int *map, footer;
+  const char **names;
+  Block block[3];
+  FILE *file;
+  Flat f;
+  Entry *e;
+  size_t pos[4];
+  static const int footersizes[] = {2, 4, 4, 4};
+  msg(1, "writing merged table of %u benchmarks to '%s'", nsyms, arrowpath);
+  cells = calloc(n * nzummaries + 1, sizeof *cells);
+  nulls = calloc(nzummaries + 1, sizeof *nulls);
+  map = malloc((nzummaries + 1) * sizeof *map);
+  names = malloc((n + 1) * sizeof *names);
+  nodes = malloc(2 * (1 + m * nzummaries) * sizeof *nodes);
+  buffers = malloc(4 * (1 + m * nzummaries) * sizeof *buffers);
+  column = malloc(8 * n + 8);
+  if (!cells || !nulls || !map || !names || !nodes || !buffers || !column)
+    die("out of memory allocating merged table");
+  for (i = 0; i < nzummaries; i++)
+    map[zummaries[i]->id] = i;
+  for (i = 0; i < n; i++) {
+    names[i] = symtab[i]->name;
+    for (idx = symtab[i]->first; idx; idx = ENTRY(idx)->chain)
+      cells[i * nzummaries + map[ENTRY(idx)->zummary]] = idx;
+    for (j = 0; j < nzummaries; j++)
+      if (!cells[i * nzummaries + j])
+        nulls[j]++;
+  }
+  if (!(file = fopen(arrowpath, "w")))
+    die("can not write '%s'", arrowpath);
+  memset(&f, 0, sizeof f);
+  arrowposition = 0;
+  writearrowbytes(file, "ARROW1\0\0", 8);
+  flatschema(&f, flatmessage(&f, ARROW_SCHEMA, 0), skip);
+  writearrowmessage(file, &f, 0);
+  writearrowstrings(file, &f, 0, n, names, block);
+  writearrowstrings(file, &f, 1, sizeof arrowstatus / sizeof *arrowstatus,
+                    arrowstatus, block + 1);
+  nodes[0] = n, nodes[1] = 0;
+  buffers[0] = buffers[1] = 0;
+  buffers[2] = 0, buffers[3] = 4 * n;
+  offset = (4 * n + 7) & ~7ull;
+  for (j = 0; j < nzummaries; j++) {
+    unsigned long long voffset = 0, vlength = 0;
+    if (nulls[j])
+      voffset = offset, vlength = validity, offset += vbytes;
+    for (k = 0; k < m; k++) {
+      unsigned long long *b = buffers + 4 * (1 + m * j + k);
+      unsigned width = k ? k == 1 ? 4 : 8 : 1;
+      nodes[2 * (1 + m * j + k)] = n;
+      nodes[2 * (1 + m * j + k) + 1] = nulls[j];
+      b[0] = voffset, b[1] = vlength;
+      b[2] = offset, b[3] = width * n;
+      offset += (width * n + 7) & ~7ull;
+    }
+  }
+  body = offset;
+  flatbatch(&f, flatmessage(&f, ARROW_RECORD, body), n, 1 + m * nzummaries,
+            nodes, 2 * (1 + m * nzummaries), buffers);
+  writearrowmessage(file, &f, block + 2);
+  block[2].body = body;
+  for (i = 0; i < n; i++)
+    ((int *)column)[i] = i;
+  writearrowbytes(file, column, 4 * n);
+  writearrowpadding(file);
+  for (j = 0; j < nzummaries; j++) {
+    if (nulls[j]) {
+      memset(column, 0, vbytes);
+      for (i = 0; i < n; i++)
+        if (cells[i * nzummaries + j])
+          column[i / 8] |= 1 << (i % 8);
+      writearrowbytes(file, column, vbytes);
+    }
+    for (k = 0; k < m; k++) {
+      for (i = 0; i < n; i++) {
+        idx = cells[i * nzummaries + j];
+        e = entry(idx);
+        switch (k) {
+        case 0:
+          column[i] = e ? arrowstatuscode(e->res) : 0;
+          break;
+        case 1:
+          ((int *)column)[i] = e ? e->bnd : 0;
+          break;
+        case 2:
+        case 3:
+        case 4:
+          ((double *)column)[i] =
+              !e ? 0 : k == 2 ? WLL(e) : k == 3 ? TIM(e) : MEM(e);
+          break;
+        default:
+          ((double *)column)[i] = e ? VALUE(idx, k - 5) : 0;
+          break;
+        }
+      }
+      writearrowbytes(file, column, (k ? k == 1 ? 4 : 8 : 1) * n);
+      writearrowpadding(file);
+    }
+  }
+  writearrowbytes(file, "\377\377\377\377\0\0\0\0", 8);
+  f.size = 0;
+  offset = arrowposition;
+  flattable(&f, flatalloc(&f, 4, 8), 4, footersizes, pos);
+  flatput(&f, pos[0], ARROW_VERSION, 2);
+  flatschema(&f, pos[1], skip);
+  for (k = 0; k < 2; k++) {
+    unsigned first = k ? 2 : 0, count = k ? 1 : 2;
+    size_t vector = flatvector(&f, pos[2 + k], count, 24);
+    for (i = 0; i < count; i++) {
+      flatput(&f, vector + 24 * i, block[first + i].offset, 8);
+      flatput(&f, vector + 24 * i + 8, block[first + i].metadata, 4);
+      flatput(&f, vector + 24 * i + 16, block[first + i].body, 8);
+    }
+  }
+  writearrowbytes(file, f.bytes, f.size);
+  footer = f.size;
+  putu32(file, footer);
+  arrowposition += 4;
+  writearrowbytes(file, "ARROW1", 6);
+  if (fclose(file))
+    die("failed to close '%s'", arrowpath);
+  free(f.bytes);
+  free(column);
+  free(buffers);
+  free(nodes);
+  free(names);
+  free(map);
+  free(nulls);
+  free(cells);
+}
+
+static void printrankedsymbol(Symbol *s) {
+  int c = s->sat + s->uns;
+  if (solved && !c)
+    return;
+  if (unsolved && c)
+    return;
+  if (json) {
+    jsonrecord("rank");
+    jsontext("benchmark", s->name);
+    jsonint("solved", c);
+    jsonfinish();
+  } else
+    printf("%d %s\n", s->sat + s->uns, s->name);
+}
+
+static void printranked() {
+  int i;
+  for (i = 0; i < nsyms; i++)
+    printrankedsymbol(symtab[i]);
+}
+
+/*------------------------------------------------------------------------*/
+
+/* The streaming engine reads all 'zummary' files in parallel through one
+ * cursor per directory and merges them by instance name.  Since these files
+ * are written sorted, all entries of one instance are then adjacent and are
+ * analyzed together as a 'group', before the cursors move on.  Thus only
+ * one entry per directory is kept in memory.  Each cursor has its own
+ * symbol at index 'k + 1' in 'symbols' while parsing, and during analysis
+ * the entries of a group are linked into the scratch symbol at index '0'.
+ * Similarly the optimum of the current entry of cursor 'k' is kept in
+ * 'optima[k]' for the scratch symbol, which thus stays sorted for
+ * 'getoptimum'.  The current name of a cursor stays valid while the next
+ * line is read as lines are read alternatingly into two buffers.  Limits
+ * read from a file are checked against the copy 'limits' of its zummary,
+ * since the limits of the zummary itself might be forced to other values
+ * before streaming.
+ */
+
+static int splitcursorline(Cursor *c, char *p) {
+  int n = 0;
+  for (;;) {
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+      p++;
+    if (!*p)
+      break;
+    if (n == sizeof c->tokens / sizeof *c->tokens)
+      break; // ignore metric columns
+    c->tokens[n].start = p;
+    while (*p && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+      p++;
+    c->tokens[n].size = p - c->tokens[n].start;
+    n++;
+    if (*p)
+      *p++ = 0;
+  }
+  return n;
+}
+
+static int readcursorline(Cursor *c) {
+  int n;
+  c->current = !c->current;
+  if (getline(c->lines + c->current, c->sizelines + c->current, c->file) < 0)
+    n = 0;
+  else
+    n = splitcursorline(c, c->lines[c->current]);
+  if (!n) {
+    fclose(c->file);
+    c->file = 0;
+  }
+  return n;
+}
+
+static int readcursor(Cursor *c) {
+  const char *prev = c->ntokens ? c->tokens[0].start : 0;
+  Entry *e = ENTRY(c->entry);
+  int n;
+  if (!c->file)
+    return c->ntokens = 0;
+  if (!(n = readcursorline(c)))
+    return c->ntokens = 0;
+  if (n < 8)
+    die("invalid line in '%s'", c->path);
+  if (prev && strcmp(prev, c->tokens[0].start) >= 0)
+    die("entries in '%s' not sorted (try without '--stream')", c->path);
+  symbols[c - cursors + 1]->name = (char *)c->tokens[0].start;
+  memset(e, 0, sizeof *e);
+  e->symbol = c - cursors + 1;
+  e->zummary = c->zummary->id;
+  e->bnd = -1;
+  parsezummaryentry(&c->limits, e, c->tokens, n < 9 ? n : 9, c->path);
+  if (c->line >= 0 && c->line < n)
+    e->line = spanline(c->tokens[c->line], c->path);
+  if (c->optimum >= 0 && c->optimum < n &&
+      (optima[c - cursors].obnd = spandecimal(c->tokens[c->optimum])) >= 0)
+    e->opt = 1;
+  applyparseoptions(e);
+  return c->ntokens = n;
+}
+
+static void opencursors() {
+  Symbol *s;
+  int i, n;
+  ncursors = nzummaries;
+  cursors = calloc(ncursors, sizeof *cursors);
+  heap = malloc(ncursors * sizeof *heap);
+  s = calloc(ncursors + 1, sizeof *s);
+  if (!cursors || !heap || !s)
+    die("out of memory allocating cursors");
+  if (sizesymbols < ncursors + 1) {
+    symbols = realloc(symbols, (ncursors + 1) * sizeof *symbols);
+    if (!symbols)
+      die("out of memory reallocating symbols stack");
+    sizesymbols = ncursors + 1;
+  }
+  for (i = 0; i <= ncursors; i++)
+    symbols[i] = s + i, s[i].id = i;
+  if (sizeoptima < (unsigned)ncursors) {
+    optima = realloc(optima, ncursors * sizeof *optima);
+    if (!optima)
+      die("out of memory reallocating optima stack");
+    sizeoptima = ncursors;
+  }
+  noptima = ncursors;
+  for (i = 0; i < ncursors; i++) {
+    optima[i].symbol = 0;
+    optima[i].zummary = zummaries[i]->id;
+    optima[i].obnd = -1;
+  }
+  for (i = 0; i < ncursors; i++) {
+    Cursor *c = cursors + i;
+    Zummary *z = zummaries[i];
+    assert(z == directories[i]);
+    c->zummary = z;
+    c->limits = *z;
+    c->path = appendpath(z->path, "zummary");
+    c->entry = newentryindex(z);
+    if (!(c->file = fopen(c->path, "r"))) {
+      msg(1, "no zummary '%s' to stream", c->path);
+      continue;
+    }
+    msg(1, "streaming zummary '%s'", c->path);
+    if ((n = readcursorline(c)) && !iszummaryheader(c->tokens, n))
+      die("invalid header in '%s'", c->path);
+    c->line = namedcolumn(c->tokens, n, "line");
+    c->optimum = namedcolumn(c->tokens, n, "optimum");
+    z->cnt = readcursor(c) > 0;
+    z->tlim = c->limits.tlim;
+    z->rlim = c->limits.rlim;
+    z->slim = c->limits.slim;
+  }
+}
+
+static void closecursors() {
+  int i;
+  cursorbytes = ncursors * (sizeof *cursors + sizeof *heap + sizeof(Symbol));
+  for (i = 0; i < ncursors; i++) {
+    Cursor *c = cursors + i;
+    cursorbytes += c->sizelines[0] + c->sizelines[1];
+    if (c->file)
+      fclose(c->file);
+    free(c->lines[0]);
+    free(c->lines[1]);
+    free(c->path);
+  }
+  free(symbols[0]);
+  free(cursors);
+  free(heap);
+}
+
+static int cmpcursors(int i, int j) {
+  const char *a = cursors[i].tokens[0].start, *b = cursors[j].tokens[0].start;
+  int res = strcmp(a, b);
+  return res ? res : i - j;
+}
+
+static void pushcursor(int i) {
+  int j = nheap++, k;
+  while (j && cmpcursors(i, heap[k = (j - 1) / 2]) < 0)
+    heap[j] = heap[k], j = k;
+  heap[j] = i;
+}
+
+static int popcursor() {
+  int res = heap[0], i = heap[--nheap], j = 0, k;
+  while ((k = 2 * j + 1) < nheap) {
+    if (k + 1 < nheap && cmpcursors(heap[k + 1], heap[k]) < 0)
+      k++;
+    if (cmpcursors(i, heap[k]) <= 0)
+      break;
+    heap[j] = heap[k], j = k;
+  }
+  heap[j] = i;
+  return res;
+}
+
+/* Links the entries of the cursors with the smallest name into the scratch
+ * symbol in the order of the directories (ties are broken by index).
+ */
+static Symbol *nextgroup() {
+  Symbol *s = symbols[0];
+  const char *name;
+  Cursor *c;
+  assert(nheap);
+  name = cursors[heap[0]].tokens[0].start;
+  s->name = (char *)name;
+  s->first = s->last = s->best = 0;
+  s->sat = s->uns = 0;
+  while (nheap && !strcmp(cursors[heap[0]].tokens[0].start, name)) {
+    c = cursors + popcursor();
+    ENTRY(c->entry)->symbol = 0;
+    ENTRY(c->entry)->chain = 0;
+    if (s->last)
+      ENTRY(s->last)->chain = c->entry;
+    else
+      s->first = c->entry;
+    s->last = c->entry;
+  }
+  return s;
+}
+
+static void advancegroup(Symbol *s) {
+  unsigned i, next;
+  for (i = s->first; i; i = next) {
+    Entry *e = ENTRY(i);
+    next = e->chain;
+    if (readcursor(cursors + e->zummary))
+      pushcursor(e->zummary);
+  }
+}
+
+static void streamall() {
+  int i, count = 0, open = 0, discrepant = 0, skip = 0;
+  Entry *e;
+  Symbol *s;
+  opencursors();
+  for (i = 0; i < nzummaries; i++)
+    forcelimits(zummaries[i]);
+  checklimits();
+  if (merge)
+    skip = skiprefixlength();
+  else
+    for (i = 0; i < nzummaries; i++)
+      startfix(zummaries[i], GLOBAL_ZUMMARY_DO_NOT_HAVE_BEST);
+  for (i = 0; i < ncursors; i++)
+    if (cursors[i].ntokens)
+      pushcursor(i);
+  while (nheap) {
+    s = nextgroup();
+    for (e = entry(s->first); e; e = entry(e->chain))
+      fixlimits(ZUMMARY(e), e);
+    discrepant += resultdiscrepancy(s);
+    bounddiscrepancy(s);
+    if (merge) {
+      if (!count)
+        printmergedheader(s);
+      printmergedsymbol(s, skip);
+    } else {
+      for (e = entry(s->first); e; e = entry(e->chain))
+        fixentry(ZUMMARY(e), e, GLOBAL_ZUMMARY_DO_NOT_HAVE_BEST);
+      findbestsymbol(s);
+      for (e = entry(s->first); e; e = entry(e->chain)) {
+        fixentry(ZUMMARY(e), e, GLOBAL_ZUMMARY_HAVE_BEST);
+        countentry(ZUMMARY(e), e, GLOBAL_ZUMMARY_HAVE_BEST);
+      }
+      open += isunsolved(s);
+      for (e = entry(s->first); e; e = entry(e->chain))
+        adddeep(ZUMMARY(e), e);
+      if (solved || unsolved || rank)
+        printrankedsymbol(s);
+    }
+    count++;
+    advancegroup(s);
+  }
+  msg(1, "streamed %d benchmarks", count);
+  reportdiscrepancies(discrepant);
+  if (!merge) {
+    for (i = 0; i < nzummaries; i++)
+      finishfix(zummaries[i], GLOBAL_ZUMMARY_HAVE_BEST);
+    finishdeep(count, open);
+    sortzummaries();
+    if (!solved && !unsolved && !rank)
+      printzummaries();
+  }
+  writeflush(&output);
+  jsonclose();
+  closecursors();
+}
+
+#define HDRSUB 4
+#define HDRBUCKETS (64 * HDRSUB)
+
+/* Log-linear buckets as in HDR histograms: values below '2 * HDRSUB' get
+ * their own bucket, then every power of two is split into 'HDRSUB' equally
+ * sized sub-buckets, which bounds the relative error by '1 / HDRSUB'.
+ */
+static int hdrbucket(unsigned long long v) {
+  int e = 0;
+  if (v < 2 * HDRSUB)
+    return v;
+  while ((v >> e) >= 2 * HDRSUB)
+    e++;
+  return (e + 1) * HDRSUB + (int)(v >> e) - HDRSUB;
+}
+
+static unsigned long long hdrlower(int b) {
+  if (b < 2 * HDRSUB)
+    return b;
+  return (unsigned long long)(HDRSUB + b % HDRSUB) << (b / HDRSUB - 1);
+}
+
+static unsigned long long microseconds(double seconds) {
+  return seconds * 1e6 + 0.5;
+}
+
+static void printhistogram(Parsed *p, int n) {
+  FILE *file = DIAGNOSTICS;
+  static const double percentiles[] = {50, 90, 99, 99.9};
+  int buckets[HDRBUCKETS], b, i, j, sum;
+  double seconds = 0, max = 0;
+  long bytes = 0;
+  for (b = 0; b < HDRBUCKETS; b++)
+    buckets[b] = 0;
+  for (i = 0; i < n; i++) {
+    buckets[hdrbucket(microseconds(p[i].seconds))]++;
+    seconds += p[i].seconds, bytes += p[i].bytes;
+    if (p[i].seconds > max)
+      max = p[i].seconds;
+  }
+  fprintf(file,
+          "\nparse latency of '%s' (%d files, %.3f seconds, %ld bytes)\n\n",
+          p->zummary->path, n, seconds, bytes);
+  fprintf(file, "%12s %12s %8s %8s %8s\n", "from [ms]", "to [ms]", "files",
+          "percent", "cumul");
+  for (b = sum = 0; b < HDRBUCKETS; b++) {
+    if (!buckets[b])
+      continue;
+    sum += buckets[b];
+    fprintf(file, "%12.3f %12.3f %8d %7.2f%% %7.2f%%\n", hdrlower(b) / 1e3,
+            hdrlower(b + 1) / 1e3, buckets[b], 100.0 * buckets[b] / n,
+            100.0 * sum / n);
+  }
+  fputc('\n', file);
+  for (j = 0; j < sizeof percentiles / sizeof *percentiles; j++) {
+    for (b = sum = 0; b < HDRBUCKETS; b++)
+      if ((sum += buckets[b]) >= percentiles[j] * n / 100)
+        break;
+    fprintf(file, "p%g %.3f ms, ", percentiles[j],
+            b < HDRBUCKETS && hdrlower(b + 1) < 1e6 * max
+                ? hdrlower(b + 1) / 1e3
+                : 1e3 * max);
+  }
+  fprintf(file, "max %.3f ms\n", 1e3 * max);
+}
+
+static int cmpslow4qsort(const void *p, const void *q) {
+  Parsed *a = *(Parsed **)p, *b = *(Parsed **)q;
+  int res;
+  if ((res = cmpdouble(b->seconds, a->seconds)))
+    return res;
+  return strcmp(a->path, b->path);
+}
+
+static int cmplarge4qsort(const void *p, const void *q) {
+  Parsed *a = *(Parsed **)p, *b = *(Parsed **)q;
+  if (a->bytes != b->bytes)
+    return a->bytes < b->bytes ? 1 : -1;
+  return strcmp(a->path, b->path);
+}
+
+static void printtop(Parsed **a, const char *what, double seconds) {
+  FILE *file = DIAGNOSTICS;
+  int i, n = slow < nparsed ? slow : nparsed;
+  fprintf(file, "\n%d %s files:\n\n", n, what);
+  fprintf(file, "%12s %7s %14s  %s\n", "[ms]", "share", "bytes", "path");
+  for (i = 0; i < n; i++)
+    fprintf(file, "%12.3f %6.2f%% %14ld  %s\n", 1e3 * a[i]->seconds,
+            seconds > 0 ? 100 * a[i]->seconds / seconds : 0.0, a[i]->bytes,
+            a[i]->path);
+}
+
+static void printslow() {
+  FILE *file = DIAGNOSTICS;
+  double seconds = 0;
+  Parsed **a;
+  int i, j;
+  if (nparsed <= 0) {
+    fprintf(file, "\nno files parsed (all zummaries cached, try '-f')\n");
+    return;
+  }
+  for (i = 0; i < nparsed; i = j) {
+    for (j = i + 1; j < nparsed; j++)
+      if (parsed[j].zummary != parsed[i].zummary)
         break;
-      }
-      printf(";%d", e->bnd);
-      printf(";%.02f", e->wll);
-      printf(";%.02f", e->tim);
-      printf(";%.1f", e->mem);
-    }
-    printf("\n");
+    printhistogram(parsed + i, j - i);
   }
+  a = malloc(nparsed * sizeof *a);
+  if (!a)
+    die("out of memory allocating parsed files table");
+  temporary(nparsed * sizeof *a);
+  for (i = 0; i < nparsed; i++)
+    a[i] = parsed + i, seconds += parsed[i].seconds;
+  qsort(a, nparsed, sizeof *a, cmpslow4qsort);
+  printtop(a, "slowest", seconds);
+  qsort(a, nparsed, sizeof *a, cmplarge4qsort);
+  printtop(a, "largest", seconds);
+  free(a);
 }
 
-static void printranked() {
+static long maxrss() {
+  struct rusage u;
+  if (getrusage(RUSAGE_SELF, &u))
+    return -1;
+#ifdef __APPLE__
+  return u.ru_maxrss;
+#else
+  return u.ru_maxrss * 1024l;
+#endif
+}
+
+static void printbytes(size_t bytes, size_t total, const char *what) {
+  FILE *file = DIAGNOSTICS;
+  fprintf(file, "%14zu %6.2f%% %11.1f MB  %s\n", bytes,
+          total ? 100.0 * bytes / total : 0.0, bytes / (double)(1 << 20), what);
+}
+
+/* Payload bytes of our own data structures.  This ignores allocator
+ * overhead, which is what makes the difference to the peak RSS.
+ */
+static void printmemory() {
+  FILE *file = DIAGNOSTICS;
+  size_t entries, syms, names, buckets, buffers, zummarystack, files;
+  size_t total, n = nentries ? nentries - 1 : 0;
+  long rss;
   int i;
-  for (i = 0; i < nsyms; i++) {
-    Symbol *s = symtab[i];
-    int c = s->sat + s->uns;
-    if (solved && !c)
-      continue;
-    if (unsolved && c)
-      continue;
-    printf("%d %s\n", s->sat + s->uns, s->name);
-  }
+  entries = nblocks * (size_t)BLOCK * sizeof(Entry);
+  entries += sizeblocks * sizeof *blocks + sizeoptima * sizeof *optima;
+  syms = nsyms * sizeof(Symbol) + sizesymbols * sizeof *symbols;
+  names = 0;
+  for (i = 0; i < nsyms; i++)
+    names += strlen(symbols[i]->name) + 1;
+  buckets = sizesymtab * sizeof *symtab;
+  buffers = sizetoken + sizetokens * sizeof *tokens;
+  zummarystack = sizezummaries * sizeof *zummaries;
+  zummarystack += nzummaries * sizeof(Zummary);
+  for (i = 0; i < nzummaries; i++)
+    zummarystack += strlen(zummaries[i]->path) + 1;
+  files = sizeparsed * sizeof *parsed;
+  for (i = 0; i < nparsed; i++)
+    files += strlen(parsed[i].path) + 1;
+  total = entries + syms + names + buckets + buffers + zummarystack;
+  total += files + maxtemporary + cursorbytes;
+  fprintf(file, "\nmemory usage of %zu entries and %u symbols:\n\n", n, nsyms);
+  printbytes(entries, total, "entries");
+  printbytes(syms, total, "symbols");
+  printbytes(names, total, "names");
+  printbytes(buckets, total, "symbol table buckets");
+  printbytes(buffers, total, "token buffers");
+  printbytes(zummarystack, total, "zummaries");
+  if (files)
+    printbytes(files, total, "parsed files");
+  if (cursorbytes)
+    printbytes(cursorbytes, total, "stream cursors");
+  printbytes(maxtemporary, total, "maximum temporary sort array");
+  printbytes(total, total, "total");
+  if (!stream)
+    fprintf(file, "\n%zu bytes per entry (%zu entry, %zu symbol and name)\n",
+            n ? total / n : 0, sizeof(Entry), n ? (syms + names) / n : 0);
+  else
+    fprintf(file, "\n");
+  if ((rss = maxrss()) >= 0)
+    fprintf(file, "%ld bytes (%.1f MB) peak resident set size\n", rss,
+            rss / (double)(1 << 20));
 }
 
-static void zummarizeall() {
+static void savereport(Report *r) {
+#define OPTION(TYPE, NAME) r->NAME = NAME;
+  REPORT_OPTIONS
+#undef OPTION
+}
+
+static void loadreport(Report *r) {
+#define OPTION(TYPE, NAME) NAME = r->NAME;
+  REPORT_OPTIONS
+#undef OPTION
+}
+
+static void savesettings(Settings *s) {
+#define OPTION(TYPE, NAME) s->NAME = NAME;
+  SESSION_OPTIONS
+#undef OPTION
+  s->nmetrics = nmetrics;
+}
+
+static void loadsettings(Settings *s) {
+#define OPTION(TYPE, NAME) NAME = s->NAME;
+  SESSION_OPTIONS
+#undef OPTION
+  while (nmetrics > s->nmetrics)
+    free(metrics[--nmetrics].name);
+  deletekeywords(keywords);
+  keywords = 0;
+}
+
+static void analyze() {
   msg(2, "%u benchmarks (%llu searched, %llu collisions %.2f on average)",
       nsyms, searches, collisions,
       searches ? collisions / (double)searches : 1.0);
   sortsymbols();
+  fixalllimits();
   discrepancies();
   checklimits();
-  if (merge)
+}
+
+static void project() {
+  fixzummaries(GLOBAL_ZUMMARY_HAVE_BEST);
+  computedeep();
+  sortzummaries();
+}
+
+static void printreport() {
+  project();
+  if (solved || unsolved || rank)
+    printranked();
+  else if (plotting)
+    plot();
+  else if (cmp)
+    compare();
+  else if (spaceprofile)
+    printspaceprofile();
+  else if (matrix)
+    printmatrix();
+  else if (portfolio)
+    printportfolio();
+  else if (sweep)
+    printsweep();
+  else {
+    printzummaries();
+    if (deeponly)
+      printdeep();
+  }
+}
+
+static void zummarizeall() {
+  analyze();
+  if (arrowpath)
+    writearrow();
+  else if (merge)
     printmerged();
   else {
     fixzummaries(GLOBAL_ZUMMARY_DO_NOT_HAVE_BEST);
     findbest();
-    fixzummaries(GLOBAL_ZUMMARY_HAVE_BEST);
-    computedeep();
-    sortzummaries();
-    if (solved || unsolved || rank)
-      printranked();
-    else if (plotting)
-      plot();
-    else if (cmp)
-      compare();
-    else {
-      printzummaries();
-      if (deeponly)
-        printdeep();
-    }
+    printreport();
   }
+  jsonclose();
+}
+
+/* Output of reports is redirected to the file given with '-o' unless it is
+ * a plot, where '-o' already denotes the generated PDF file.
+ */
+static void runreport(Report *r) {
+  int fd, saved = -1;
+  loadreport(r);
+  msg(1, "generating report '%s'", r->spec);
+  if (outputpath && !plotting) {
+    fflush(stdout);
+    if ((fd = open(outputpath, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
+      die("can not write report '%s'", outputpath);
+    if ((saved = dup(1)) < 0 || dup2(fd, 1) < 0)
+      die("can not redirect report to '%s'", outputpath);
+    close(fd);
+  }
+  if (arrowpath)
+    writearrow();
+  else if (merge)
+    printmerged();
+  else
+    printreport();
+  jsonclose();
+  if (saved >= 0) {
+    fflush(stdout);
+    dup2(saved, 1);
+    close(saved);
+  }
+}
+
+/* All reports share loading, discrepancy checking and finding the best
+ * entries.  The merged reports have to be generated before the status of
+ * entries is fixed, while the other reports only differ in how they
+ * project the statistics of each zummary.
+ */
+static void reportall() {
+  int i;
+  analyze();
+  for (i = 0; i < nreports; i++)
+    if (reports[i].merge)
+      runreport(reports + i);
+  fixzummaries(GLOBAL_ZUMMARY_DO_NOT_HAVE_BEST);
+  findbest();
+  for (i = 0; i < nreports; i++)
+    if (!reports[i].merge)
+      runreport(reports + i);
+}
+
+/* After an error in the library files might still be open, which are
+ * closed here.  A partially written cache file is left behind.
+ */
+static void releasefiles() {
+  release_input();
+  release_directory();
+  if (cache.file) {
+    (void)fclose(cache.file);
+    cache.file = 0;
+  }
+  cache.size = 0;
 }
 
 static void reset() {
   int i;
+  releasefiles();
   for (i = 0; i < nzummaries; i++) {
     Zummary *z = zummaries[i];
-    Entry *e, *n;
-    for (e = z->first; e; e = n) {
-      n = e->next;
-      free(e);
-    }
+    free(z->metrics);
     free(z->path);
     free(z);
   }
   free(zummaries);
+  free(directories);
+  for (i = 0; i < nblocks; i++)
+    free(blocks[i]);
+  free(blocks);
+  free(optima);
   free(tokens);
   free(token);
+#ifdef NMMAP
+  free(linebuffer);
+  linebuffer = 0, sizelinebuffer = 0;
+#endif
   for (i = 0; i < nsyms; i++) {
-    Symbol *s = symtab[i];
+    Symbol *s = symbols[i];
     free(s->name);
     free(s);
   }
   free(symtab);
+  free(symbols);
   for (i = 0; i < norder; i++)
     free(order[i].name);
   free(order);
+  for (i = 0; i < nparsed; i++)
+    free(parsed[i].path);
+  free(parsed);
+  for (i = 0; i < nreports; i++) {
+    if (reports[i].argv)
+      free(reports[i].argv[0]);
+    free(reports[i].argv);
+    free(reports[i].spec);
+  }
+  free(reports);
+  zummaries = directories = 0;
+  nzummaries = sizezummaries = 0;
+  loaded = written = updated = 0;
+  token = 0, tokens = 0;
+  ntoken = sizetoken = ntokens = sizetokens = lineno = 0;
+  symtab = symbols = 0;
+  nsyms = sizesymtab = sizesymbols = 0;
+  blocks = 0, optima = 0;
+  nentries = nblocks = sizeblocks = noptima = sizeoptima = 0;
+  searches = collisions = 0;
+  order = 0, norder = 0;
+  parsed = 0, nparsed = sizeparsed = 0;
+  reports = 0, nreports = sizereports = 0;
+  maxtemporary = cursorbytes = 0;
+  savedch = EOF, savedchvalid = 0;
+  deletekeywords(keywords);
+  keywords = 0;
+  for (i = 0; i < (int)nmetrics; i++)
+    free(metrics[i].name);
+  free(metrics);
+  free(values);
+  metrics = 0, nmetrics = sizemetrics = 0;
+  values = 0, sizevalues = 0;
+  free(samplebytes);
+  free(sampleoffsets);
+  free(sampled);
+  samplebytes = 0, nsamplebytes = sizesamplebytes = 0;
+  sampleoffsets = 0, sizesampleoffsets = 0;
+  sampled = 0, nsampled = sizesampled = 0;
+  samples = 0;
+  deletefilter();
 }
 
-int main(int argc, char **argv) {
-  int i, count = 0;
+/* Restores the default options, which are saved before first use, such
+ * that sessions and the front end can be run several times.
+ */
+static void initialize() {
+  if (!initialized) {
+    savereport(&defaults);
+    initialized = 1;
+  }
+  loadreport(&defaults);
+  verbose = force = ignore = nowrite = nobounds = nowarnings = just = 0;
+  forced_time_limit = forced_real_limit = -1;
+  forcereal = forcetime = usereal = 0;
+  slow = memory = stream = lazy = 0;
+  logthreads = 0;
+  fastcheck = 0, spotchecks = 0;
+  inodeorder = 0;
+  keywordspath = orderpath = emitpath = 0;
+}
+
+/* Metric names are used as column names in 'zummary' files and thus have
+ * to be single tokens different from the other column names.
+ */
+static void newmetric(const char *spec) {
+  static const char *reserved[] = {"result", "time", "real",  "space", "tlim",
+                                   "rlim",   "slim", "bound", "lazy",
+                                   "line",   "optimum"};
+  const char *colon = strchr(spec, ':'), *p;
+  Metric *m;
+  unsigned j;
+  if (!colon || colon == spec || !colon[1])
+    die("expected '<name>:<prefix>' in '--metric %s'", spec);
+  for (p = spec; p < colon; p++)
+    if (!isalnum((unsigned char)*p) && !strchr("_-./", *p))
+      die("invalid metric name in '--metric %s'", spec);
+  if (nmetrics == sizemetrics) {
+    sizemetrics = sizemetrics ? 2 * sizemetrics : 1;
+    metrics = realloc(metrics, sizemetrics * sizeof *metrics);
+    if (!metrics)
+      die("out of memory reallocating metrics");
+  }
+  m = metrics + nmetrics;
+  if (!(m->name = malloc(colon - spec + 1)))
+    die("out of memory allocating metric name");
+  memcpy(m->name, spec, colon - spec);
+  m->name[colon - spec] = 0;
+  m->prefix = colon + 1;
+  for (j = 0; j < sizeof reserved / sizeof *reserved; j++)
+    if (!strcmp(m->name, reserved[j]))
+      die("reserved metric name '%s'", m->name);
+  for (j = 0; j < nmetrics; j++)
+    if (!strcmp(m->name, metrics[j].name))
+      die("duplicate metric '%s'", m->name);
+  nmetrics++;
+}
+
+/* Parses options which affect how directories are zummarized.  These can
+ * also be set through 'zummarize_option'.
+ */
+static int parsesessionoption(int argc, char **argv, int *iptr) {
+  int i = *iptr;
+  const char *arg = argv[i];
+  if (!strcmp(arg, "-v"))
+    verbose++;
+  else if (!strcmp(arg, "--no-warnings") || !strcmp(arg, "-n"))
+    nowarnings = 1;
+  else if (!strcmp(arg, "--force") || !strcmp(arg, "-f"))
+    force = 1;
+  else if (!strcmp(arg, "--ignore") || !strcmp(arg, "-i"))
+    ignore = 1;
+  else if (!strcmp(arg, "--just") || !strcmp(arg, "-j"))
+    just = 1;
+  else if (!strcmp(arg, "--forced-real-limit")) {
+    if (++i == argc)
+      die("argument to '%s' missing", arg);
+    if ((forced_real_limit = atoi(argv[i])) < 0)
+      die("invalid '%s %s'", arg, argv[i]);
+  } else if (!strcmp(arg, "--forced-time-limit")) {
+    if (++i == argc)
+      die("argument to '%s' missing", arg);
+    if ((forced_time_limit = atoi(argv[i])) < 0)
+      die("invalid '%s %s'", arg, argv[i]);
+  } else if (!strcmp(arg, "--no-write"))
+    nowrite = 1;
+  else if (!strcmp(arg, "--no-bounds"))
+    nobounds = 1;
+  else if (!strcmp(arg, "--force-real"))
+    forcereal = 1;
+  else if (!strcmp(arg, "--force-time"))
+    forcetime = 1;
+  else if (!strcmp(arg, "--lazy"))
+    lazy = 1;
+  else if (!strcmp(arg, "--log-threads")) {
+    if (++i == argc)
+      die("argument to '%s' missing", arg);
+    if ((int)(logthreads = atoi(argv[i])) <= 0)
+      die("invalid '%s %s'", arg, argv[i]);
+#if defined(NMMAP) || defined(NTHREADS)
+    if (logthreads > 1)
+      die("'%s' requires memory mapping and thread support", arg);
+#endif
+  } else if (!strcmp(arg, "--keywords")) {
+    if (++i == argc)
+      die("argument to '%s' missing", arg);
+    if (!isfile(argv[i]))
+      die("keywords file '%s' not found", argv[i]);
+    keywordspath = argv[i];
+    deletekeywords(keywords);
+    keywords = 0;
+  } else if (!strcmp(arg, "--metric")) {
+    if (++i == argc)
+      die("argument to '%s' missing", arg);
+    newmetric(argv[i]);
+    deletekeywords(keywords);
+    keywords = 0;
+  } else if (!strcmp(arg, "--samples"))
+    samples = 1;
+  else if (!strcmp(arg, "--fast-check"))
+    fastcheck = 1;
+  else if (!strcmp(arg, "--spot-check")) {
+    if (++i == argc)
+      die("argument to '%s' missing", arg);
+    if ((int)(spotchecks = atoi(argv[i])) <= 0)
+      die("invalid '%s %s'", arg, argv[i]);
+    fastcheck = 1;
+  } else if (!strcmp(arg, "--inode-order"))
+    inodeorder = 1;
+  else if (!strcmp(arg, "--instances")) {
+    if (++i == argc)
+      die("argument to '%s' missing", arg);
+    readinstances(argv[i]);
+  } else if (!strcmp(arg, "--match")) {
+    if (++i == argc)
+      die("argument to '%s' missing", arg);
+    newmatch(argv[i]);
+  } else
+    return 0;
+  *iptr = i;
+  return 1;
+}
+
+/* Parses options which only affect how results are reported.  These can
+ * also be given in report specifications of '--report'.  Returns zero if
+ * 'argv[*iptr]' is not such an option.
+ */
+static int parsereportoption(int argc, char **argv, int *iptr) {
+  int i = *iptr;
+  const char *arg = argv[i];
+  if (!strcmp(arg, "--all") || !strcmp(arg, "-a"))
+    printall = 1;
+  else if (!strcmp(arg, "--sat") || !strcmp(arg, "-s"))
+    satonly = 1;
+  else if (!strcmp(arg, "--unsat") || !strcmp(arg, "-u"))
+    unsatonly = 1;
+  else if (!strcmp(arg, "--deep") || !strcmp(arg, "-d"))
+    deeponly = 1;
+  else if (!strcmp(arg, "--cactus"))
+    plotting = cactus = 1, cdf = 0;
+  else if (!strcmp(arg, "--cdf") || !strcmp(arg, "--plotting") ||
+           !strcmp(arg, "-c"))
+    plotting = cdf = 1, cactus = 0;
+  else if (!strcmp(arg, "--log") || !strcmp(arg, "-l"))
+    logarithmic = 1;
+  else if (!strcmp(arg, "--show-solved"))
+    show_solved = 1;
+  else if (!strcmp(arg, "--center"))
+    center = 1;
+  else if (!strcmp(arg, "--merge") || !strcmp(arg, "-m"))
+    merge = 1;
+  else if (!strcmp(arg, "--space-profile"))
+    spaceprofile = samples = 1;
+  else if (!strcmp(arg, "--json"))
+    json = JSON_ARRAY;
+  else if (!strcmp(arg, "--ndjson"))
+    json = JSON_LINES;
+  else if (!strcmp(arg, "--rank") || !strcmp(arg, "-r"))
+    rank = 1;
+  else if (!strcmp(arg, "--solved")) {
+    if (solved)
+      die("'--solved' specified twice");
+    if (unsolved)
+      die("can not combine '--unsolved' and '--solved'");
+    solved = 1;
+  } else if (!strcmp(arg, "--matrix"))
+    matrix = 1;
+  else if (!strcmp(arg, "--sweep")) {
+    double limits[MAXSWEEP];
+    if (++i == argc)
+      die("argument to '%s' missing", arg);
+    sweep = argv[i];
+    parsesweep(limits);
+  } else if (!strcmp(arg, "--portfolio")) {
+    if (++i == argc)
+      die("argument to '%s' missing", arg);
+    if ((portfolio = atoi(argv[i])) <= 0)
+      die("invalid '%s %s'", arg, argv[i]);
+  } else if (!strcmp(arg, "--cmp"))
+    cmp = 1;
+  else if (!strcmp(arg, "--cex")) {
+    if (++i == argc)
+	die("argument to '%s' missing", arg);
+    if ((cex = atof(argv[i])) <= 0)
+	die("invalid '%s %s'", arg, argv[i]);
+  } else if (!strcmp(arg, "--ymin")) {
+    if (++i == argc)
+      die("argument to '%s' missing", arg);
+    if ((ymin = atof(argv[i])) < 0)
+      die("invalid '%s %s'", arg, argv[i]);
+  } else if (!strcmp(arg, "--xmin")) {
+    if (++i == argc)
+      die("argument to '%s' missing", arg);
+    if ((xmin = atof(argv[i])) < 0)
+      die("invalid '%s %s'", arg, argv[i]);
+  } else if (!strcmp(arg, "--ymax")) {
+    if (++i == argc)
+      die("argument to '%s' missing", arg);
+    if ((ymax = atof(argv[i])) < 0)
+      die("invalid '%s %s'", arg, argv[i]);
+  } else if (!strcmp(arg, "--xmax")) {
+    if (++i == argc)
+      die("argument to '%s' missing", arg);
+    if ((xmax = atof(argv[i])) < 0)
+      die("invalid '%s %s'", arg, argv[i]);
+  } else if (!strcmp(arg, "--xlegend")) {
+    if (++i == argc)
+      die("argument to '%s' missing", arg);
+    if ((xlegend = atof(argv[i])) < 0)
+      die("invalid '%s %s'", arg, argv[i]);
+  } else if (!strcmp(arg, "--ylegend")) {
+    if (++i == argc)
+      die("argument to '%s' missing", arg);
+    if ((ylegend = atof(argv[i])) < 0)
+      die("invalid '%s %s'", arg, argv[i]);
+  } else if (!strcmp(arg, "--limit")) {
+    if (++i == argc)
+      die("argument to '%s' missing", arg);
+    if ((limit = atoi(argv[i])) < 0)
+      die("invalid '%s %s'", arg, argv[i]);
+  } else if (!strcmp(arg, "--patch")) {
+    if (++i == argc)
+      die("argument to '%s' missing", arg);
+    patch = argv[i];
+  } else if (!strcmp(arg, "--filter"))
+    filter = 1;
+  else if (!strcmp(arg, "--no-unknown"))
+    nounknown = 1;
+  else if (!strcmp(arg, "--unsolved")) {
+    if (unsolved)
+      die("'--unsolved' specified twice");
+    if (solved)
+      die("can not combine '--solved' and '--unsolved'");
+    unsolved = 1;
+  } else if (!strcmp(arg, "--arrow")) {
+    if (arrowpath)
+      die("multiple '--arrow' options");
+    if (i + 1 == argc)
+      die("argument to '%s' missing", arg);
+    arrowpath = argv[++i];
+    merge = 1;
+  } else if (!strcmp(arg, "-o")) {
+    if (outputpath)
+      die("multiple output paths specified");
+    if (i + 1 == argc)
+      die("argument to '-o' missing");
+    outputpath = argv[++i];
+  } else if (!strcmp(arg, "--title") || !strcmp(arg, "-t")) {
+    if (title)
+      die("title multiply defined");
+    if (i + 1 == argc)
+      die("argument to '%s' missing", arg);
+    title = argv[++i];
+  } else if (arg[0] == '-' && arg[1] == '-' && arg[2] == 'p' &&
+             arg[3] == 'a' && arg[4] == 'r') {
+    if (!isdigit(arg[5]) || (arg[6] && !isdigit(arg[6])) ||
+        (arg[6] && arg[7]))
+      die("expected one or two digits after '--par'");
+    par = atoi(arg + 5);
+  } else
+    return 0;
+  *iptr = i;
+  return 1;
+}
+
+static void newreport(const char *spec) {
+  Report *r;
+  if (nreports == sizereports) {
+    int newsizereports = sizereports ? 2 * sizereports : 1;
+    reports = realloc(reports, newsizereports * sizeof *reports);
+    if (!reports)
+      die("out of memory reallocating reports");
+    sizereports = newsizereports;
+  }
+  r = reports + nreports++;
+  memset(r, 0, sizeof *r);
+  if (!(r->spec = strdup(spec)))
+    die("out of memory copying report specification");
+}
+
+/* Splits the report specification at white space and applies its options
+ * on top of the report options given on the command line.  The library
+ * uses the same function for 'zummarize_option' and then also allows
+ * session options (and the specification is kept only to keep pointers
+ * to option arguments valid).
+ */
+static void parsereport(Report *r, int library) {
+  int argc = 0, i;
+  char *p, *q;
+  if (!(p = strdup(r->spec)))
+    die("out of memory copying report specification");
+  if (!(r->argv = malloc((strlen(p) / 2 + 2) * sizeof *r->argv)))
+    die("out of memory allocating report arguments");
+  r->argv[argc++] = p;
+  for (q = strtok(p, " \t"); q; q = strtok(0, " \t"))
+    r->argv[argc++] = q;
+  for (i = 1; i < argc; i++)
+    if (!parsereportoption(argc, r->argv, &i) &&
+        !(library && parsesessionoption(argc, r->argv, &i)))
+      die("invalid option '%s' in %s '%s'", r->argv[i],
+          library ? "options" : "report", r->spec);
+}
+
+static void checkreportoptions(Report *r, int count) {
+  assert(!cactus || !cdf);
+  if (cmp && count != 2)
+    die("'--cmp' requires two directories");
+  if (satonly && unsatonly)
+    die("'--sat-only' and '--unsat-only'");
+  if (title && !plotting)
+    die("title defined without ploting");
+  if (outputpath && !plotting && !r)
+    die("output file specfied without ploting");
+  if (plotting && merge)
+    die("can not plot and merge data");
+  if (stream && (plotting || cmp || deeponly || matrix || portfolio || sweep))
+    die("can not combine '--stream' with plotting, '--cmp', '--matrix', "
+        "'--portfolio', '--sweep' or '--deep'");
+  if (stream && arrowpath)
+    die("can not combine '--stream' and '--arrow'");
+  if (json && (plotting || arrowpath))
+    die("can not print JSON with plotting or '--arrow'");
+}
+
+/* Options with an argument which are skipped while zummarizing directories.
+ */
+static int hasargument(const char *arg) {
+  return !strcmp(arg, "-t") || !strcmp(arg, "-o") ||
+         !strcmp(arg, "--title") || !strcmp(arg, "--order") ||
+         !strcmp(arg, "--emit-partial") || !strcmp(arg, "--arrow") ||
+         !strcmp(arg, "--report") || !strcmp(arg, "--keywords") ||
+         !strcmp(arg, "--metric") || !strcmp(arg, "--spot-check") ||
+         !strcmp(arg, "--instances") || !strcmp(arg, "--match") ||
+         !strcmp(arg, "--portfolio") || !strcmp(arg, "--sweep");
+}
+
+int zummarize_main(int argc, char **argv) {
+  int i, count = 0, combined = 0;
+  initialize();
   for (i = 1; i < argc; i++) {
     const char *arg = argv[i];
+    if (parsereportoption(argc, argv, &i))
+      continue;
+    if (parsesessionoption(argc, argv, &i))
+      continue;
     if (!strcmp(arg, "-h"))
       usage();
-    else if (!strcmp(arg, "-v"))
-      verbose++;
-    else if (!strcmp(arg, "--no-warnings") || !strcmp(arg, "-n"))
-      nowarnings = 1;
-    else if (!strcmp(arg, "--all") || !strcmp(arg, "-a"))
-      printall = 1;
-    else if (!strcmp(arg, "--sat") || !strcmp(arg, "-s"))
-      satonly = 1;
-    else if (!strcmp(arg, "--unsat") || !strcmp(arg, "-u"))
-      unsatonly = 1;
-    else if (!strcmp(arg, "--deep") || !strcmp(arg, "-d"))
-      deeponly = 1;
-    else if (!strcmp(arg, "--cactus"))
-      plotting = cactus = 1, cdf = 0;
-    else if (!strcmp(arg, "--cdf") || !strcmp(arg, "--plotting") ||
-             !strcmp(arg, "-c"))
-      plotting = cdf = 1, cactus = 0;
-    else if (!strcmp(arg, "--log") || !strcmp(arg, "-l"))
-      logarithmic = 1;
-    else if (!strcmp(arg, "--show-solved"))
-      show_solved = 1;
-    else if (!strcmp(arg, "--center"))
-      center = 1;
-    else if (!strcmp(arg, "--merge") || !strcmp(arg, "-m"))
-      merge = 1;
-    else if (!strcmp(arg, "--rank") || !strcmp(arg, "-r"))
-      rank = 1;
-    else if (!strcmp(arg, "--force") || !strcmp(arg, "-f"))
-      force = 1;
-    else if (!strcmp(arg, "--ignore") || !strcmp(arg, "-i"))
-      ignore = 1;
-    else if (!strcmp(arg, "--just") || !strcmp(arg, "-j"))
-      just = 1;
-    else if (!strcmp(arg, "--solved")) {
-      if (solved)
-        die("'--solved' specified twice");
-      if (unsolved)
-        die("can not combine '--unsolved' and '--solved'");
-      solved = 1;
-    } else if (!strcmp(arg, "--cmp"))
-      cmp = 1;
-    else if (!strcmp(arg, "--cex")) {
-      if (++i == argc)
-	die("argument to '%s' missing", arg);
-      if ((cex = atof(argv[i])) <= 0)
-	die("invalid '%s %s'", arg, argv[i]);
-    } else if (!strcmp(arg, "--ymin")) {
-      if (++i == argc)
-        die("argument to '%s' missing", arg);
-      if ((ymin = atof(argv[i])) < 0)
-        die("invalid '%s %s'", arg, argv[i]);
-    } else if (!strcmp(arg, "--xmin")) {
-      if (++i == argc)
-        die("argument to '%s' missing", arg);
-      if ((xmin = atof(argv[i])) < 0)
-        die("invalid '%s %s'", arg, argv[i]);
-    } else if (!strcmp(arg, "--ymax")) {
-      if (++i == argc)
-        die("argument to '%s' missing", arg);
-      if ((ymax = atof(argv[i])) < 0)
-        die("invalid '%s %s'", arg, argv[i]);
-    } else if (!strcmp(arg, "--xmax")) {
+    else if (!strcmp(arg, "--slow")) {
       if (++i == argc)
         die("argument to '%s' missing", arg);
-      if ((xmax = atof(argv[i])) < 0)
+      if ((slow = atoi(argv[i])) <= 0)
         die("invalid '%s %s'", arg, argv[i]);
-    } else if (!strcmp(arg, "--xlegend")) {
-      if (++i == argc)
-        die("argument to '%s' missing", arg);
-      if ((xlegend = atof(argv[i])) < 0)
-        die("invalid '%s %s'", arg, argv[i]);
-    } else if (!strcmp(arg, "--ylegend")) {
-      if (++i == argc)
-        die("argument to '%s' missing", arg);
-      if ((ylegend = atof(argv[i])) < 0)
-        die("invalid '%s %s'", arg, argv[i]);
-    } else if (!strcmp(arg, "--limit")) {
-      if (++i == argc)
-        die("argument to '%s' missing", arg);
-      if ((limit = atoi(argv[i])) < 0)
-        die("invalid '%s %s'", arg, argv[i]);
-    } else if (!strcmp(arg, "--forced-real-limit")) {
-      if (++i == argc)
-        die("argument to '%s' missing", arg);
-      if ((forced_real_limit = atoi(argv[i])) < 0)
-        die("invalid '%s %s'", arg, argv[i]);
-    } else if (!strcmp(arg, "--forced-time-limit")) {
-      if (++i == argc)
+    } else if (!strcmp(arg, "--order")) {
+      if (orderpath)
+        die("multiple '--order' options");
+      if (i + 1 == argc)
         die("argument to '%s' missing", arg);
-      if ((forced_time_limit = atoi(argv[i])) < 0)
-        die("invalid '%s %s'", arg, argv[i]);
-    } else if (!strcmp(arg, "--patch")) {
-      if (++i == argc)
+      orderpath = argv[++i];
+    } else if (!strcmp(arg, "--memory"))
+      memory = 1;
+    else if (!strcmp(arg, "--stream"))
+      stream = 1;
+    else if (!strcmp(arg, "--report")) {
+      if (i + 1 == argc)
         die("argument to '%s' missing", arg);
-      patch = argv[i];
-    } else if (!strcmp(arg, "--filter"))
-      filter = 1;
-    else if (!strcmp(arg, "--no-unknown"))
-      nounknown = 1;
-    else if (!strcmp(arg, "--unsolved")) {
-      if (unsolved)
-        die("'--unsolved' specified twice");
-      if (solved)
-        die("can not combine '--solved' and '--unsolved'");
-      unsolved = 1;
-    } else if (!strcmp(arg, "-o")) {
-      if (outputpath)
-        die("multiple output paths specified");
+      newreport(argv[++i]);
+    } else if (!strcmp(arg, "--emit-partial")) {
+      if (emitpath)
+        die("multiple '--emit-partial' options");
       if (i + 1 == argc)
-        die("argument to '-o' missing");
-      outputpath = argv[++i];
-    } else if (!strcmp(arg, "--title") || !strcmp(arg, "-t")) {
-      if (title)
-        die("title multiply defined");
+        die("argument to '%s' missing", arg);
+      emitpath = argv[++i];
+    } else if (!strcmp(arg, "--combine")) {
       if (i + 1 == argc)
         die("argument to '%s' missing", arg);
-      title = argv[++i];
-    } else if (!strcmp(arg, "--order")) {
-      if (orderpath)
-        die("multiple '--order' options");
+      if (!isfile(argv[++i]))
+        die("partial '%s' not found", argv[i]);
+      combined++, count++;
+    } else if (!strcmp(arg, "--recursive")) {
       if (i + 1 == argc)
         die("argument to '%s' missing", arg);
-      orderpath = argv[++i];
-    } else if (!strcmp(arg, "--no-write"))
-      nowrite = 1;
-    else if (!strcmp(arg, "--no-bounds"))
-      nobounds = 1;
-    else if (!strcmp(arg, "--force-real"))
-      forcereal = 1;
-    else if (!strcmp(arg, "--force-time"))
-      forcetime = 1;
-    else if (!strcmp(arg, "--update")) {
+      if (!isdir(argv[++i]))
+        die("root directory '%s' not found", argv[i]);
+      count++;
+    } else if (!strcmp(arg, "--update")) {
       if (system("./update.sh"))
         die("calling './update.sh' failed");
-    } else if (arg[0] == '-' && arg[1] == '-' && arg[2] == 'p' &&
-               arg[3] == 'a' && arg[4] == 'r') {
-      if (!isdigit(arg[5]) || (arg[6] && !isdigit(arg[6])) ||
-          (arg[6] && arg[7]))
-        die("expected one or two digits after '--par'");
-      par = atoi(arg + 5);
     } else if (arg[0] == '-')
       die("invalid option '%s' (try '-h')", arg);
     else if (!isdir(arg))
@@ -3062,19 +8079,36 @@ int main(int argc, char **argv) {
     else
       count++;
   }
-  assert(!cactus || !cdf);
   if (!count)
     die("no directory specified (try '-h')");
-  if (cmp && count != 2)
-    die("'--cmp' requires two directories");
-  if (satonly && unsatonly)
-    die("'--sat-only' and '--unsat-only'");
-  if (title && !plotting)
-    die("title defined without ploting");
-  if (outputpath && !plotting)
-    die("output file specfied without ploting");
-  if (plotting && merge)
-    die("can not plot and merge data");
+  if (!nreports)
+    checkreportoptions(0, count);
+  else {
+    Report base;
+    if (stream)
+      die("can not combine '--stream' and '--report'");
+    if (emitpath)
+      die("can not combine '--emit-partial' and '--report'");
+    if (outputpath && nreports > 1)
+      die("output file for several reports (use '-o' in each '--report')");
+    savereport(&base);
+    for (i = 0; i < nreports; i++) {
+      loadreport(&base);
+      parsereport(reports + i, 0);
+      checkreportoptions(reports + i, count);
+      savereport(reports + i);
+    }
+    loadreport(&base);
+  }
+  if (stream && (emitpath || combined))
+    die("can not use partials with '--stream'");
+  if (nmetrics && (stream || emitpath || combined))
+    die("can not combine '--metric' with '--stream', '--emit-partial' "
+        "or '--combine'");
+  if (samples && (stream || emitpath))
+    die("can not combine '--samples' with '--stream' or '--emit-partial'");
+  if (filtered && stream)
+    die("can not combine '--instances' or '--match' with '--stream'");
   if (nowrite)
     msg(1, "will not write zummaries");
   else
@@ -3091,16 +8125,238 @@ int main(int argc, char **argv) {
     msg(1, "using par%d score", par);
   if (orderpath)
     parseorder();
-  for (i = 1; i < argc; i++) {
+  if (combined) {
+    for (i = 1; i < argc; i++)
+      if (hasargument(argv[i]) || !strcmp(argv[i], "--recursive"))
+        i++;
+      else if (!strcmp(argv[i], "--combine"))
+        readpartial(argv[++i]);
+    groupshards();
+  }
+  for (i = 1, combined = 0; i < argc; i++) {
     const char *arg = argv[i];
-    if (!strcmp(arg, "-t") || !strcmp(arg, "-o") || !strcmp(arg, "--title") ||
-        !strcmp(arg, "--order"))
+    if (hasargument(arg))
       i++;
+    else if (!strcmp(arg, "--combine"))
+      i++, combinepartial(combined++);
+    else if (!strcmp(arg, "--recursive"))
+      walkrecursive(argv[++i]);
     else if (arg[0] != '-' && isdir(arg))
       zummarizeone(argv[i]);
   }
-  zummarizeall();
-  reset();
+  if (npartials)
+    releasepartials();
+  if (emitpath)
+    writepartial(emitpath);
+  else if (stream)
+    streamall();
+  else if (nreports)
+    reportall();
+  else
+    zummarizeall();
+  if (slow)
+    printslow();
+  if (memory)
+    printmemory();
   msg(1, "%d loaded, %d updated, %d written", loaded, updated, written);
+  reset();
+  return 0;
+}
+
+/*------------------------------------------------------------------------*/
+
+/* Every API function which might call 'die' first arms 'errorjmp', such
+ * that errors return to it instead of exiting the process.
+ */
+#define CHECK(S)                                                               \
+  do {                                                                         \
+    if (!(S) || (S) != session)                                                \
+      return -1;                                                               \
+    if ((S)->broken) {                                                         \
+      snprintf(errormessage, sizeof errormessage,                              \
+               "session broken by previous error");                            \
+      return -1;                                                               \
+    }                                                                          \
+  } while (0)
+
+#define CATCH(S, BREAK)                                                        \
+  do {                                                                         \
+    if (setjmp((S)->env)) {                                                    \
+      errorjmp = 0;                                                            \
+      releasefiles();                                                          \
+      (S)->broken = (BREAK);                                                   \
+      return -1;                                                               \
+    }                                                                          \
+    errorjmp = &(S)->env;                                                      \
+  } while (0)
+
+zummarize_session *zummarize_open(void) {
+  if (session)
+    return 0;
+  if (!(session = malloc(sizeof *session)))
+    return 0;
+  memset(session, 0, sizeof *session);
+  initialize();
+  errormessage[0] = 0;
+  return session;
+}
+
+void zummarize_close(zummarize_session *s) {
+  if (!s || s != session)
+    return;
+  errorjmp = 0;
+  reset();
+  free(session);
+  session = 0;
+}
+
+const char *zummarize_error(zummarize_session *s) {
+  if (!s || s != session)
+    return "invalid session";
+  return errormessage;
+}
+
+/* Options are applied one at a time, thus on errors all options are
+ * restored from the snapshots taken before parsing and the report holding
+ * the failed options is dropped.
+ */
+int zummarize_option(zummarize_session *s, const char *options) {
+  unsigned before = nreports;
+  Settings settings;
+  Report saved, *r;
+  CHECK(s);
+  savereport(&saved);
+  savesettings(&settings);
+  if (setjmp(s->env)) {
+    errorjmp = 0;
+    releasefiles();
+    if (nreports > before) {
+      r = reports + --nreports;
+      if (r->argv)
+        free(r->argv[0]);
+      free(r->argv);
+      free(r->spec);
+    }
+    loadreport(&saved);
+    loadsettings(&settings);
+    return -1;
+  }
+  errorjmp = &s->env;
+  newreport(options);
+  r = reports + nreports - 1;
+  savereport(r);
+  parsereport(r, 1);
+  if (satonly && unsatonly)
+    die("can not combine '--sat' and '--unsat'");
+  errorjmp = 0;
+  return 0;
+}
+
+int zummarize_add(zummarize_session *s, const char *directory) {
+  CHECK(s);
+  if (s->analyzed) {
+    snprintf(errormessage, sizeof errormessage,
+             "can not add '%s' after analysis", directory);
+    return -1;
+  }
+  if (!isdir(directory)) {
+    snprintf(errormessage, sizeof errormessage, "'%s' not a directory",
+             directory);
+    return -1;
+  }
+  CATCH(s, 1);
+  zummarizeone(directory);
+  errorjmp = 0;
+  return 0;
+}
+
+int zummarize_analyze(zummarize_session *s) {
+  CHECK(s);
+  CATCH(s, 1);
+  if (!s->analyzed) {
+    analyze();
+    fixzummaries(GLOBAL_ZUMMARY_DO_NOT_HAVE_BEST);
+    findbest();
+    s->analyzed = 1;
+  }
+  project();
+  errorjmp = 0;
+  return 0;
+}
+
+int zummarize_zummaries(zummarize_session *s) {
+  CHECK(s);
+  return nzummaries;
+}
+
+int zummarize_get_zummary(zummarize_session *s, int i, zummarize_zummary *res) {
+  Zummary *z;
+  CHECK(s);
+  if (i < 0 || i >= nzummaries)
+    return -1;
+  z = zummaries[i];
+  res->path = z->path;
+  res->cnt = z->cnt, res->sol = z->sol, res->sat = z->sat;
+  res->uns = z->uns, res->dis = z->dis, res->fld = z->fld;
+  res->tio = z->tio, res->meo = z->meo, res->s11 = z->s11;
+  res->si6 = z->si6, res->unk = z->unk, res->bnd = z->bnd;
+  res->bst = z->bst, res->unq = z->unq;
+  res->wll = z->wll, res->tim = z->tim, res->par = z->par;
+  res->mem = z->mem, res->max = z->max, res->deep = z->deep;
+  res->tlim = z->tlim, res->rlim = z->rlim, res->slim = z->slim;
+  res->entries = z->last - z->first;
+  return 0;
+}
+
+int zummarize_symbols(zummarize_session *s) {
+  CHECK(s);
+  return nsyms;
+}
+
+int zummarize_get_symbol(zummarize_session *s, int i, zummarize_symbol *res) {
+  Symbol *symbol;
+  CHECK(s);
+  if (i < 0 || i >= nsyms)
+    return -1;
+  symbol = symbols[i];
+  res->name = symbol->name;
+  res->sat = symbol->sat;
+  res->uns = symbol->uns;
+  return 0;
+}
+
+int zummarize_entries(zummarize_session *s, int i) {
+  Zummary *z;
+  CHECK(s);
+  if (i < 0 || i >= nzummaries)
+    return -1;
+  z = zummaries[i];
+  return z->last - z->first;
+}
+
+int zummarize_get_entry(zummarize_session *s, int i, int j,
+                        zummarize_entry *res) {
+  Zummary *z;
+  Entry *e;
+  CHECK(s);
+  if (i < 0 || i >= nzummaries)
+    return -1;
+  z = zummaries[i];
+  if (j < 0 || j >= z->last - z->first)
+    return -1;
+  e = ENTRY(z->first + j);
+  res->name = NAME(e);
+  res->path = z->path;
+  res->symbol = e->symbol;
+  res->res = e->res;
+  res->bnd = e->bnd;
+  res->best = s->analyzed && SYMBOL(e)->best == z->first + j;
+  res->tim = TIM(e);
+  res->wll = WLL(e);
+  res->mem = MEM(e);
   return 0;
 }
+
+#ifndef NMAIN
+int main(int argc, char **argv) { return zummarize_main(argc, argv); }
+#endif
@@ -0,0 +1,84 @@
+#ifndef _zummarize_h_INCLUDED
+#define _zummarize_h_INCLUDED
+
+/* C API of 'libzummarize' for embedding zummarize into other tools.
+ *
+ * A session is opened, options are set, directories are added (loading or
+ * updating their 'zummary' files as the command line tool does), and then
+ * the results are analyzed.  Afterwards zummaries, benchmarks (symbols)
+ * and entries can be iterated by index.  The library uses global state,
+ * thus only one session can be open at a time.
+ *
+ * Functions returning 'int' return a negative value on error, in which
+ * case 'zummarize_error' gives the error message.  Errors while adding
+ * directories or analyzing leave the session in an inconsistent state and
+ * all further calls on it fail until it is closed.  Failing to set options
+ * can be recovered from, since then all options given in that call are
+ * undone (except for instances already read with '--instances').
+ */
+
+typedef struct zummarize_session zummarize_session;
+
+/* Result codes 'res' of entries after analysis.
+ */
+#define ZUMMARIZE_TIME 1        /* time limit reached */
+#define ZUMMARIZE_MEMORY 2      /* space limit reached */
+#define ZUMMARIZE_UNKNOWN 3     /* no result */
+#define ZUMMARIZE_DISCREPANCY 4 /* result contradicted by others */
+#define ZUMMARIZE_SIGSEGV 5     /* segmentation fault (signal 11) */
+#define ZUMMARIZE_SIGABRT 6     /* aborted (signal 6) */
+#define ZUMMARIZE_SAT 10
+#define ZUMMARIZE_UNSAT 20
+
+typedef struct zummarize_zummary {
+  const char *path;
+  int cnt, sol, sat, uns, dis, fld, tio, meo, s11, si6, unk, bnd, bst, unq;
+  double wll, tim, par, mem, max, tlim, rlim, slim, deep;
+  int entries;
+} zummarize_zummary;
+
+typedef struct zummarize_symbol {
+  const char *name;
+  int sat, uns; /* number of non-discrepant results after analysis */
+} zummarize_symbol;
+
+typedef struct zummarize_entry {
+  const char *name, *path; /* benchmark and directory */
+  int symbol;              /* index of benchmark for 'zummarize_symbol' */
+  int res, bnd, best;      /* 'best' is non-zero for best entry */
+  double tim, wll, mem;    /* process and real time in seconds, MB */
+} zummarize_entry;
+
+zummarize_session *zummarize_open(void);
+void zummarize_close(zummarize_session *);
+const char *zummarize_error(zummarize_session *);
+
+/* Takes white space separated command line options, e.g., "-f --no-write"
+ * for loading or "--sat --par2" for analyzing.
+ */
+int zummarize_option(zummarize_session *, const char *options);
+
+int zummarize_add(zummarize_session *, const char *directory);
+
+/* Analyzes all added directories.  Calling it again after changing report
+ * options (like '--sat') only recomputes the statistics of the zummaries.
+ * Directories can not be added after analysis.
+ */
+int zummarize_analyze(zummarize_session *);
+
+/* Zummaries are ranked after analysis and otherwise in the order they were
+ * added.  Entries are given per zummary sorted by benchmark name.
+ */
+int zummarize_zummaries(zummarize_session *);
+int zummarize_get_zummary(zummarize_session *, int, zummarize_zummary *);
+int zummarize_symbols(zummarize_session *);
+int zummarize_get_symbol(zummarize_session *, int, zummarize_symbol *);
+int zummarize_entries(zummarize_session *, int zummary);
+int zummarize_get_entry(zummarize_session *, int zummary, int entry,
+                        zummarize_entry *);
+
+/* The command line front end (exits on errors).
+ */
+int zummarize_main(int argc, char **argv);
+
+#endif